@@ -0,0 +1,18 @@
+QT = core
+CONFIG += console c++2a
+CONFIG -= app_bundle
+
+# Offline statistics over archives written by OvenCommTest, build with qmake OvenAnalyze.pro
+TARGET = OvenAnalyze
+TEMPLATE = app
+
+SOURCES += \
+    analyzemain.cpp \
+    telemetryanalysis.cpp \
+    telemetryarchive.cpp \
+    workstealingpool.cpp
+
+HEADERS += \
+    telemetryanalysis.h \
+    telemetryarchive.h \
+    workstealingpool.h
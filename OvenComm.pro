@@ -1,26 +1,75 @@
-QT += widgets serialport
+QT += widgets serialport concurrent network
+CONFIG += c++2a
+linux-g++*: QMAKE_CXXFLAGS += -fcoroutines
 requires(qtConfig(combobox))
 
 TARGET = OvenCommTest
 TEMPLATE = app
 
 SOURCES += \
+    adaptivepoller.cpp \
+    alarmengine.cpp \
+    allocationcounter.cpp \
+    latencytrace.cpp \
+    linkprobe.cpp \
     main.cpp \
     mainwindow.cpp \
     ovencomm.cpp \
+    ovengateway.cpp \
+    ovenprofile.cpp \
+    ovenstation.cpp \
+    portenumerator.cpp \
+    profileengine.cpp \
+    serialbus.cpp \
     serialcomm.cpp \
-    settingsdialog.cpp
+    settingsdialog.cpp \
+    stationcheckpoint.cpp \
+    telemetryarchive.cpp \
+    telemetryrecorder.cpp \
+    telemetryserver.cpp \
+    timerwheel.cpp
 
 HEADERS += \
+    adaptivepoller.h \
+    alarmengine.h \
+    allocationcounter.h \
+    devicecomm.h \
+    gatewayprotocol.h \
+    latencytrace.h \
+    linkprobe.h \
     mainwindow.h \
+    ovenbus.h \
     ovencomm.h \
+    ovencoro.h \
+    ovengateway.h \
+    ovenprofile.h \
+    ovenprotocol.h \
+    ovenstation.h \
+    portenumerator.h \
+    profileengine.h \
+    protocoltraits.h \
+    ringqueue.h \
+    serialbus.h \
     serialcomm.h \
-    settingsdialog.h
+    settingsdialog.h \
+    stationcheckpoint.h \
+    telemetryarchive.h \
+    telemetryrecorder.h \
+    telemetryserver.h \
+    timerwheel.h
 
 FORMS += \
     mainwindow.ui \
     settingsdialog.ui
 
+# counts every heap allocation in the process, see SerialComm::poolStats()
+count_allocations: DEFINES += OVENCOMM_COUNT_ALLOCATIONS
+
+linux {
+    SOURCES += epollserialloop.cpp
+    HEADERS += epollserialloop.h
+}
+
 RESOURCES += \
     OvenComm.qrc
 
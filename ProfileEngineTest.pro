@@ -0,0 +1,38 @@
+QT = core network serialport widgets testlib
+CONFIG += console c++2a testcase
+CONFIG -= app_bundle
+
+# Unit test for profileengine.cpp, build with qmake ProfileEngineTest.pro and run with make check.
+# settingsdialog.h is left out of HEADERS, only its Settings struct is used
+TARGET = tst_profileengine
+TEMPLATE = app
+
+SOURCES += \
+    alarmengine.cpp \
+    allocationcounter.cpp \
+    latencytrace.cpp \
+    ovencomm.cpp \
+    profileengine.cpp \
+    serialbus.cpp \
+    serialcomm.cpp \
+    timerwheel.cpp \
+    tst_profileengine.cpp
+
+HEADERS += \
+    alarmengine.h \
+    allocationcounter.h \
+    gatewayprotocol.h \
+    latencytrace.h \
+    ovencomm.h \
+    ovenprotocol.h \
+    profileengine.h \
+    protocoltraits.h \
+    ringqueue.h \
+    serialbus.h \
+    serialcomm.h \
+    timerwheel.h
+
+linux {
+    SOURCES += epollserialloop.cpp
+    HEADERS += epollserialloop.h
+}
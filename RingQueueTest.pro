@@ -0,0 +1,13 @@
+QT = core testlib
+CONFIG += console c++2a testcase
+CONFIG -= app_bundle
+
+# Unit test for ringqueue.h, build with qmake RingQueueTest.pro and run with make check
+TARGET = tst_ringqueue
+TEMPLATE = app
+
+SOURCES += \
+    tst_ringqueue.cpp
+
+HEADERS += \
+    ringqueue.h
@@ -0,0 +1,180 @@
+#include "adaptivepoller.h"
+#include "serialbus.h"
+#include <QHash>
+#include <QPointer>
+#include <QtMath>
+
+namespace {
+// running pollers and link budgets, one set per thread like the timer wheel
+QList<AdaptivePoller*> &threadPollers() {
+    static thread_local QList<AdaptivePoller*> pollers;
+    return pollers;
+}
+
+// keyed by line, a SerialBus or a link with a port of its own
+QHash<const QObject*, double> &lineBudgets() {
+    static thread_local QHash<const QObject*, double> budgets;
+    return budgets;
+}
+
+const QObject *lineOf(const SerialComm *link) {
+    const SerialBus *bus = link->sharedBus();
+    return bus ? static_cast<const QObject*>(bus) : link;
+}
+}
+
+AdaptivePoller::AdaptivePoller(OvenComm *oven, QObject *parent) : QObject(parent), oven(oven) {
+    qRegisterMetaType<AdaptivePoller::Sample>();
+    connect(&poll_timer, &QTimer::timeout, this, &AdaptivePoller::poll);
+    poll_timer.setInterval(wanted_interval);
+}
+
+AdaptivePoller::~AdaptivePoller() {
+    stop();
+}
+
+void AdaptivePoller::setIntervalRange(int min_ms, int max_ms) {
+    min_interval = qMax(1, min_ms);
+    max_interval = qMax(min_interval, max_ms);
+    wanted_interval = qBound(min_interval, wanted_interval, max_interval);
+    rebalance(lineOf(oven));
+}
+
+void AdaptivePoller::setThresholds(double temp_rate, int output_step) {
+    temp_rate_threshold = temp_rate;
+    output_step_threshold = output_step;
+}
+
+void AdaptivePoller::start(int from_interval_ms) {
+    if (isRunning()) {
+        return;
+    }
+    // nothing known about the oven yet, start fast
+    wanted_interval = from_interval_ms > 0 ? qBound(min_interval, from_interval_ms, max_interval) : min_interval;
+    has_previous = false;
+    threadPollers().append(this);
+    rebalance(lineOf(oven));
+    poll_timer.start();
+    poll();
+}
+
+void AdaptivePoller::stop() {
+    poll_timer.stop();
+    if (threadPollers().removeOne(this)) {
+        rebalance(lineOf(oven));
+    }
+}
+
+bool AdaptivePoller::isRunning() const {
+    return poll_timer.isActive();
+}
+
+int AdaptivePoller::interval() const {
+    return poll_timer.interval();
+}
+
+void AdaptivePoller::setLinkBudget(SerialComm *link, double frames_per_second) {
+    QHash<const QObject*, double> &budgets = lineBudgets();
+    const QObject *line = lineOf(link);
+    if (frames_per_second <= 0.0) {
+        budgets.remove(line);
+    } else {
+        if (!budgets.contains(line)) {
+            // a later line at the same address must not inherit it
+            connect(line, &QObject::destroyed, [line]() { lineBudgets().remove(line); });
+        }
+        budgets[line] = frames_per_second;
+    }
+    rebalance(line);
+}
+
+double AdaptivePoller::linkBudget(const SerialComm *link) {
+    return lineBudgets().value(lineOf(link), 0.0);
+}
+
+void AdaptivePoller::replyReceived(const SerialComm::Reply &reply) {
+    if (!reply.ok) {
+        cycle_failed = true;
+    } else if (reply.command == OvenComm::GETTEMP) {
+        current.temp = reply.value / 100.0;
+        current.sampled_ns = reply.times.last_byte_ns ? reply.times.last_byte_ns : SerialComm::monotonicNs();
+    } else if (reply.command == OvenComm::GETOUTPUT) {
+        current.output = reply.value;
+    }
+
+    if (--pending == 0 && !cycle_failed) {
+        adapt();
+    }
+}
+
+void AdaptivePoller::adapt() {
+    bool moving = false;
+    current.temp_rate = 0.0;
+    if (has_previous && current.sampled_ns > previous.sampled_ns) {
+        double dt = (current.sampled_ns - previous.sampled_ns) / 1e9;
+        current.temp_rate = (current.temp - previous.temp) / dt;
+        moving = qAbs(current.temp_rate) >= temp_rate_threshold
+                || qAbs(current.output - previous.output) >= output_step_threshold;
+    }
+
+    if (moving) {
+        wanted_interval = min_interval;
+    } else if (has_previous) {
+        // steady, back off geometrically
+        wanted_interval = qMin(wanted_interval * 2, max_interval);
+    }
+
+    previous = current;
+    has_previous = true;
+    emit sampled(current);
+    rebalance(lineOf(oven));
+}
+
+void AdaptivePoller::applyInterval(int interval_ms) {
+    if (poll_timer.interval() != interval_ms) {
+        poll_timer.setInterval(interval_ms);
+        emit intervalChanged(interval_ms);
+    }
+}
+
+void AdaptivePoller::rebalance(const QObject *line) {
+    const QList<AdaptivePoller*> &pollers = threadPollers();
+    const double budget = lineBudgets().value(line, 0.0);
+
+    double demand = 0.0;
+    for (AdaptivePoller *poller : pollers) {
+        if (lineOf(poller->oven) == line) {
+            demand += frames_per_poll * 1000.0 / poller->wanted_interval;
+        }
+    }
+
+    double scale = 1.0;
+    if (budget > 0.0 && demand > budget) {
+        scale = demand / budget;
+    }
+
+    for (AdaptivePoller *poller : pollers) {
+        if (lineOf(poller->oven) == line) {
+            poller->applyInterval(qCeil(poller->wanted_interval * scale));
+        }
+    }
+}
+
+//Slots
+void AdaptivePoller::poll() {
+    // previous cycle still queued behind other traffic, do not pile up more
+    if (pending > 0 || !oven->isOpen()) {
+        return;
+    }
+
+    pending = frames_per_poll;
+    cycle_failed = false;
+    QPointer<AdaptivePoller> guard(this);
+    SerialComm::ReplyCallback callback = [guard](const SerialComm::Reply &reply) {
+        if (guard) {
+            guard->replyReceived(reply);
+        }
+    };
+    oven->getTemp(SerialComm::POLLING, callback);
+    oven->getOutput(SerialComm::POLLING, callback);
+}
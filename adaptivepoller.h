@@ -0,0 +1,74 @@
+#ifndef ADAPTIVEPOLLER_H
+#define ADAPTIVEPOLLER_H
+
+#include <QObject>
+#include <QTimer>
+#include "ovencomm.h"
+
+// Polls GETTEMP and GETOUTPUT at POLLING priority, fast while the oven is moving and
+// backing off while it sits still. Each physical line can be given a budget in frames
+// per second, shared by the pollers on it; when the sum of their wanted rates goes
+// over it all of them are slowed down by the same factor. The controllers of an RS-485
+// bus are links of their own on one half-duplex line, so they share the bus's budget.
+// Pollers on other lines are not affected.
+class AdaptivePoller : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Sample {
+        double temp = 0.0;
+        int output = 0;
+        double temp_rate = 0.0; // degrees per second since the previous sample
+        qint64 sampled_ns = 0;  // SerialComm::monotonicNs() of the GETTEMP reply
+    };
+
+    static const int frames_per_poll = 2;
+
+    explicit AdaptivePoller(OvenComm *oven, QObject *parent = nullptr);
+    ~AdaptivePoller();
+
+    void setIntervalRange(int min_ms, int max_ms);
+    void setThresholds(double temp_rate, int output_step);
+
+    void start(int from_interval_ms = 0); // e.g. the interval of a restored checkpoint
+    void stop();
+    bool isRunning() const;
+    int interval() const;
+
+    // budget of the line link is on, its bus if it has been added to one, so set it
+    // after SerialBus::addLink. 0, the default, means unlimited
+    static void setLinkBudget(SerialComm *link, double frames_per_second);
+    static double linkBudget(const SerialComm *link);
+
+signals:
+    void sampled(AdaptivePoller::Sample sample);
+    void intervalChanged(int interval_ms);
+
+private:
+    void replyReceived(const SerialComm::Reply &reply);
+    void adapt();
+    void applyInterval(int interval_ms);
+    static void rebalance(const QObject *line);
+
+    OvenComm *oven;
+    QTimer poll_timer;
+    int min_interval = 250;
+    int max_interval = 5000;
+    int wanted_interval = 250; // before the link budget is applied
+    double temp_rate_threshold = 0.5;
+    int output_step_threshold = 500;
+
+    int pending = 0;
+    bool cycle_failed = false;
+    Sample current;
+    Sample previous;
+    bool has_previous = false;
+
+private slots:
+    void poll();
+};
+
+Q_DECLARE_METATYPE(AdaptivePoller::Sample)
+
+#endif // ADAPTIVEPOLLER_H
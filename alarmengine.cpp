@@ -0,0 +1,244 @@
+#include "alarmengine.h"
+#include "serialcomm.h"
+#include <QtMath>
+
+RollingStats::RollingStats(qint64 window_ms) {
+    setWindow(window_ms);
+}
+
+void RollingStats::setWindow(qint64 window_ms) {
+    window_ns = qMax<qint64>(1, window_ms) * 1000000;
+    if (!samples.isEmpty()) {
+        evict(samples.last().sampled_ns);
+        rebuild();
+    }
+}
+
+qint64 RollingStats::window() const {
+    return window_ns / 1000000;
+}
+
+void RollingStats::add(qint64 sampled_ns, double value) {
+    evict(sampled_ns);
+    if (samples.isEmpty()) {
+        base_ns = sampled_ns;
+        base_value = value;
+    }
+
+    Entry entry = {sampled_ns, value};
+    samples.enqueue(entry);
+
+    double t = (sampled_ns - base_ns) / 1e9;
+    double y = value - base_value;
+    sum_t += t;
+    sum_tt += t * t;
+    sum_y += y;
+    sum_yy += y * y;
+    sum_ty += t * y;
+
+    while (!min_queue.isEmpty() && min_queue.last().value >= value) {
+        min_queue.removeLast();
+    }
+    min_queue.append(entry);
+    while (!max_queue.isEmpty() && max_queue.last().value <= value) {
+        max_queue.removeLast();
+    }
+    max_queue.append(entry);
+
+    // one full pass per window worth of samples keeps add() O(1) amortized
+    if (++since_rebuild >= samples.size()) {
+        rebuild();
+    }
+}
+
+void RollingStats::clear() {
+    samples.clear();
+    min_queue.clear();
+    max_queue.clear();
+    rebuild();
+}
+
+int RollingStats::count() const {
+    return samples.size();
+}
+
+double RollingStats::last() const {
+    return samples.isEmpty() ? 0.0 : samples.last().value;
+}
+
+double RollingStats::mean() const {
+    return samples.isEmpty() ? 0.0 : base_value + sum_y / samples.size();
+}
+
+double RollingStats::min() const {
+    return min_queue.isEmpty() ? 0.0 : min_queue.first().value;
+}
+
+double RollingStats::max() const {
+    return max_queue.isEmpty() ? 0.0 : max_queue.first().value;
+}
+
+double RollingStats::stddev() const {
+    int n = samples.size();
+    if (n < 2) {
+        return 0.0;
+    }
+    double variance = (sum_yy - sum_y * sum_y / n) / (n - 1);
+    return variance > 0.0 ? qSqrt(variance) : 0.0;
+}
+
+double RollingStats::slope() const {
+    int n = samples.size();
+    if (n < 2) {
+        return 0.0;
+    }
+    double denominator = n * sum_tt - sum_t * sum_t;
+    if (denominator <= 1e-12) {
+        return 0.0;
+    }
+    return (n * sum_ty - sum_t * sum_y) / denominator;
+}
+
+void RollingStats::evict(qint64 now_ns) {
+    const qint64 cutoff = now_ns - window_ns;
+    while (!samples.isEmpty() && samples.first().sampled_ns < cutoff) {
+        Entry entry = samples.dequeue();
+        double t = (entry.sampled_ns - base_ns) / 1e9;
+        double y = entry.value - base_value;
+        sum_t -= t;
+        sum_tt -= t * t;
+        sum_y -= y;
+        sum_yy -= y * y;
+        sum_ty -= t * y;
+    }
+    while (!min_queue.isEmpty() && min_queue.first().sampled_ns < cutoff) {
+        min_queue.removeFirst();
+    }
+    while (!max_queue.isEmpty() && max_queue.first().sampled_ns < cutoff) {
+        max_queue.removeFirst();
+    }
+}
+
+void RollingStats::rebuild() {
+    sum_t = sum_tt = sum_y = sum_yy = sum_ty = 0.0;
+    since_rebuild = 0;
+    if (samples.isEmpty()) {
+        return;
+    }
+
+    base_ns = samples.first().sampled_ns;
+    base_value = samples.first().value;
+    for (const Entry &entry : samples) {
+        double t = (entry.sampled_ns - base_ns) / 1e9;
+        double y = entry.value - base_value;
+        sum_t += t;
+        sum_tt += t * t;
+        sum_y += y;
+        sum_yy += y * y;
+        sum_ty += t * y;
+    }
+}
+
+
+void AlarmEngine::addRule(const Rule &rule) {
+    RuleState state;
+    state.rule = rule;
+    rule_states.append(state);
+    if (!command_stats.contains(rule.command)) {
+        command_stats.insert(rule.command, RollingStats());
+    }
+}
+
+void AlarmEngine::clearRules() {
+    rule_states.clear();
+}
+
+QList<AlarmEngine::Rule> AlarmEngine::rules() const {
+    QList<Rule> result;
+    for (const RuleState &state : rule_states) {
+        result.append(state.rule);
+    }
+    return result;
+}
+
+void AlarmEngine::setWindow(int command, qint64 window_ms) {
+    command_stats[command].setWindow(window_ms);
+}
+
+const RollingStats *AlarmEngine::stats(int command) const {
+    auto it = command_stats.constFind(command);
+    return it == command_stats.constEnd() ? nullptr : &it.value();
+}
+
+void AlarmEngine::reset() {
+    for (RollingStats &stats : command_stats) {
+        stats.clear();
+    }
+    for (RuleState &state : rule_states) {
+        state.active = false;
+    }
+}
+
+void AlarmEngine::evaluate(int command, double value, qint64 frame_ns, QList<Alarm> &changed) {
+    auto it = command_stats.find(command);
+    if (it == command_stats.end()) {
+        return;
+    }
+    RollingStats &stats = it.value();
+    stats.add(frame_ns ? frame_ns : SerialComm::monotonicNs(), value);
+
+    for (RuleState &state : rule_states) {
+        const Rule &rule = state.rule;
+        if (rule.command != command) {
+            continue;
+        }
+        // spread and slope mean nothing until there are two samples
+        if ((rule.metric == STDDEV || rule.metric == SLOPE) && stats.count() < 2) {
+            continue;
+        }
+
+        double metric = metricValue(stats, rule.metric);
+        bool hit = crossed(metric, rule.comparison, rule.threshold);
+        if (hit != state.active) {
+            state.active = hit;
+
+            Alarm alarm;
+            alarm.name = rule.name;
+            alarm.command = command;
+            alarm.value = metric;
+            alarm.active = hit;
+            alarm.power_off = rule.power_off;
+            alarm.frame_ns = frame_ns;
+            alarm.evaluated_ns = SerialComm::monotonicNs();
+            changed.append(alarm);
+        }
+    }
+}
+
+double AlarmEngine::metricValue(const RollingStats &stats, int metric) {
+    switch(metric) {
+        case MEAN:
+            return stats.mean();
+        case MIN:
+            return stats.min();
+        case MAX:
+            return stats.max();
+        case STDDEV:
+            return stats.stddev();
+        case SLOPE:
+            return stats.slope();
+        default:
+            return stats.last();
+    }
+}
+
+bool AlarmEngine::crossed(double value, int comparison, double threshold) {
+    switch(comparison) {
+        case BELOW:
+            return value < threshold;
+        case NOT_EQUAL:
+            return !qFuzzyCompare(value + 1.0, threshold + 1.0);
+        default:
+            return value > threshold;
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef ALARMENGINE_H
+#define ALARMENGINE_H
+
+#include <QHash>
+#include <QMetaType>
+#include <QList>
+#include <QString>
+#include "ringqueue.h"
+
+// Mean, min/max, stddev and least squares slope over a sliding time window.
+// add() is amortized O(1): sums are updated incrementally, min/max come from
+// monotonic queues, and the sums are rebuilt from the window once per window
+// length of samples so floating point drift can not build up. The queues keep their
+// slots, once the window has filled up add() does not allocate.
+class RollingStats
+{
+public:
+    explicit RollingStats(qint64 window_ms = 60000);
+
+    void setWindow(qint64 window_ms);
+    qint64 window() const;
+    void add(qint64 sampled_ns, double value);
+    void clear();
+
+    int count() const;
+    double last() const;
+    double mean() const;
+    double min() const;
+    double max() const;
+    double stddev() const;
+    double slope() const; // value units per second
+
+private:
+    struct Entry {
+        qint64 sampled_ns;
+        double value;
+    };
+
+    void evict(qint64 now_ns);
+    void rebuild();
+
+    qint64 window_ns;
+    RingQueue<Entry> samples;
+    RingQueue<Entry> min_queue; // increasing values, front is the window min
+    RingQueue<Entry> max_queue; // decreasing values, front is the window max
+
+    // sums of t and y relative to base_ns/base_value, keeps them small
+    qint64 base_ns = 0;
+    double base_value = 0.0;
+    double sum_t = 0.0;
+    double sum_tt = 0.0;
+    double sum_y = 0.0;
+    double sum_yy = 0.0;
+    double sum_ty = 0.0;
+    int since_rebuild = 0;
+};
+
+// Threshold and rate rules checked against every decoded reply, before anything
+// is handed to the GUI. Temps are in degrees, every other value as read from the
+// controller, e.g. output saturated is {GETOUTPUT, VALUE, ABOVE, 28799}.
+class AlarmEngine
+{
+public:
+    enum metrics { VALUE=0, MEAN=1, MIN=2, MAX=3, STDDEV=4, SLOPE=5 };
+    enum comparisons { ABOVE=0, BELOW=1, NOT_EQUAL=2 };
+
+    struct Rule {
+        QString name;
+        int command = 0;
+        int metric = VALUE;
+        int comparison = ABOVE;
+        double threshold = 0.0;
+        bool power_off = false; // OvenComm turns the oven off itself when raised
+    };
+
+    struct Alarm {
+        QString name;
+        int command = 0;
+        double value = 0.0;      // metric value that crossed the threshold
+        bool active = false;     // false when the alarm clears
+        bool power_off = false;
+        qint64 frame_ns = 0;     // last byte of the reply that triggered it
+        qint64 evaluated_ns = 0; // when the rule fired, evaluated_ns - frame_ns is the reaction latency
+    };
+
+    void addRule(const Rule &rule);
+    void clearRules();
+    QList<Rule> rules() const;
+
+    void setWindow(int command, qint64 window_ms);
+    const RollingStats *stats(int command) const;
+    void reset();
+
+    // feeds one decoded value and appends every rule that changed state to changed
+    void evaluate(int command, double value, qint64 frame_ns, QList<Alarm> &changed);
+
+private:
+    struct RuleState {
+        Rule rule;
+        bool active = false;
+    };
+
+    static double metricValue(const RollingStats &stats, int metric);
+    static bool crossed(double value, int comparison, double threshold);
+
+    QList<RuleState> rule_states;
+    QHash<int, RollingStats> command_stats;
+};
+
+Q_DECLARE_METATYPE(AlarmEngine::Alarm)
+
+#endif // ALARMENGINE_H
@@ -0,0 +1,72 @@
+#include "allocationcounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef OVENCOMM_COUNT_ALLOCATIONS
+static std::atomic<qint64> allocation_count(0);
+static std::atomic<qint64> free_count(0);
+
+static void *countedAlloc(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+static void countedFree(void *pointer) {
+    if (pointer) {
+        free_count.fetch_add(1, std::memory_order_relaxed);
+        std::free(pointer);
+    }
+}
+
+void *operator new(std::size_t size) {
+    void *pointer = countedAlloc(size);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return countedAlloc(size);
+}
+
+void operator delete(void *pointer) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, std::size_t) noexcept { countedFree(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+
+bool AllocationCounter::isEnabled() {
+    return true;
+}
+
+qint64 AllocationCounter::allocations() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+qint64 AllocationCounter::frees() {
+    return free_count.load(std::memory_order_relaxed);
+}
+#else
+bool AllocationCounter::isEnabled() {
+    return false;
+}
+
+qint64 AllocationCounter::allocations() {
+    return -1;
+}
+
+qint64 AllocationCounter::frees() {
+    return -1;
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// Process wide count of operator new / delete calls, for checking that a link in
+// steady state does not allocate per command (see SerialComm::poolStats). Only
+// compiled in with CONFIG+=count_allocations, which replaces the global operators.
+namespace AllocationCounter {
+
+bool isEnabled();
+qint64 allocations();
+qint64 frees();
+
+}
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,71 @@
+#include "telemetryanalysis.h"
+#include "workstealingpool.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QTextStream>
+
+// OvenAnalyze [--tolerance deg] [--threads n] [--csv] <archive or directory>...
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("OvenAnalyze");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Per oven statistics over recorded telemetry archives");
+    parser.addHelpOption();
+    QCommandLineOption tolerance_option("tolerance", "Allowed distance from setpoint in degrees.", "degrees", "1.0");
+    QCommandLineOption threads_option("threads", "Worker threads, 0 for every core.", "count", "0");
+    QCommandLineOption csv_option("csv", "Print CSV instead of a table.");
+    parser.addOption(tolerance_option);
+    parser.addOption(threads_option);
+    parser.addOption(csv_option);
+    parser.addPositionalArgument("paths", "Archive files or directories searched for *.ovta.", "<paths...>");
+    parser.process(a);
+
+    QStringList files;
+    for (const QString &path : parser.positionalArguments()) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, QStringList() << "*.ovta", QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                files << it.next();
+            }
+        } else {
+            files << path;
+        }
+    }
+    if (files.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    const double tolerance = parser.value(tolerance_option).toDouble();
+
+    // every file gets its own result slot, merged once all workers are done
+    QVector<TelemetryAnalysis::Result> results(files.size());
+    QVector<QString> errors(files.size());
+    {
+        WorkStealingPool pool(parser.value(threads_option).toInt());
+        for (int i=0; i<files.size(); i++) {
+            pool.submit([&, i]() {
+                TelemetryAnalysis::analyzeFile(files[i], tolerance, results[i], errors[i]);
+            });
+        }
+        pool.waitForDone();
+    }
+
+    QTextStream err(stderr);
+    TelemetryAnalysis::Result total;
+    for (int i=0; i<files.size(); i++) {
+        if (!errors[i].isEmpty()) {
+            err << files[i] << ": " << errors[i] << "\n";
+        }
+        TelemetryAnalysis::merge(total, results[i]);
+    }
+
+    QTextStream out(stdout);
+    out << (parser.isSet(csv_option) ? TelemetryAnalysis::formatCsv(total)
+                                     : TelemetryAnalysis::formatTable(total));
+    return 0;
+}
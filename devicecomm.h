@@ -0,0 +1,122 @@
+#ifndef DEVICECOMM_H
+#define DEVICECOMM_H
+
+#include "serialcomm.h"
+#include "protocoltraits.h"
+
+// SerialComm link for any device described by a protocol traits struct, see
+// protocoltraits.h. Framing, checksum and scaling are all resolved at compile time,
+// the scheduling, priorities, callbacks and backends are the ones SerialComm has.
+// OvenComm uses the same FrameCodec and adds the oven specific cache, snapshots,
+// alarms and interlock on top.
+//
+// No Q_OBJECT, the signals are SerialComm's and a template cannot have its own.
+template <typename Protocol>
+class DeviceComm : public SerialComm
+{
+public:
+    typedef FrameCodec<Protocol> Codec;
+
+    explicit DeviceComm(QObject *parent = nullptr) : SerialComm(parent) {
+        connect(&serial_conn, &QSerialPort::readyRead, this, [this]() { serialConnReceiveMessage(); });
+        send_message_timer.setCallback([this]() { sendMessage(); });
+    }
+
+    // value is in device units, scaled by the command table, reads ignore it
+    bool request(int command, double value = 0.0, int priority = INTERACTIVE,
+                 const ReplyCallback &callback = ReplyCallback()) {
+        if (!Codec::command(command)) {
+            failRequest(callback, command, QSerialPort::UnsupportedOperationError);
+            return false;
+        }
+        if (!isOpen()) {
+            sendError(QSerialPort::NotOpenError, "No open connection");
+            failRequest(callback, command, QSerialPort::NotOpenError);
+            return false;
+        }
+        if (!Codec::fitsData(value * Codec::scale(command))) {
+            // the data field would wrap into a different value
+            emit errorSignal(QSerialPort::UnsupportedOperationError,
+                             QString("Value %1 is out of range").arg(value), command);
+            failRequest(callback, command, QSerialPort::UnsupportedOperationError);
+            return false;
+        }
+        const int raw = qRound(value * Codec::scale(command));
+        return enqueueRequest(command, raw, priority, callback);
+    }
+
+    static double toDeviceUnits(int command, int raw) {
+        return (double)raw / Codec::scale(command);
+    }
+
+protected:
+    void serialConnSendMessage() override {
+        char frame[Codec::request_size];
+        const int length = Codec::encodeRequest(current_request.command, current_request.value, frame);
+        if (writeSerialData(QByteArray::fromRawData(frame, length)) != -1) {
+            startReplyTimeout();
+        }
+    }
+
+    void sendError(QSerialPort::SerialPortError error, const QString &error_message) override {
+        send_message_timer.stop();
+        if (isOpen()) {
+            clearSerialData();
+        }
+        if (!request_active) {
+            emit errorSignal(error, error_message, 0);
+            return;
+        }
+        finishCurrentRequest();
+        if (current_request.group == GROUP_MEMBER) {
+            dropGroup(current_request.priority);
+        }
+        emit errorSignal(error, error_message, current_request.command);
+        completeRequest(current_request, false, 0, error);
+    }
+
+private:
+    void serialConnReceiveMessage() override {
+        const bool first_bytes = receive_length == 0;
+        if (receiveSerialData() == 0) {
+            return;
+        }
+        if (first_bytes) {
+            current_request.times.first_byte_ns = last_read_ns;
+        }
+        if (!request_active) {
+            clearReceiveBuffer();
+            return;
+        }
+
+        int value = 0;
+        const int result = Codec::decodeReply(receive_buffer, receive_length, value);
+        if (result != Codec::VALID && result != Codec::BAD_CHECKSUM) {
+            return; // more to come, or timeout() reports the partial frame
+        }
+        current_request.times.last_byte_ns = last_read_ns;
+        last_round_trip_us = (current_request.times.last_byte_ns - current_request.times.sent_ns) / 1000;
+        emitRawData();
+        timeout_timer.stop();
+
+        if (result == Codec::BAD_CHECKSUM) {
+            sendError(QSerialPort::ParityError, "Checksum mismatched");
+            return;
+        }
+        current_request.times.decoded_ns = monotonicNs();
+        finishCurrentRequest();
+        emit returnData(value, current_request.command, current_request.times);
+        completeRequest(current_request, true, value);
+        if (group_priority != -1 || !command_queue[SAFETY].isEmpty()) {
+            sendMessage();
+        }
+    }
+
+    void sendMessage() override {
+        if (isOpen() && !timeout_timer.isActive() && (request_active || takeNextRequest())) {
+            serialConnSendMessage();
+        }
+    }
+};
+
+#endif // DEVICECOMM_H
@@ -0,0 +1,74 @@
+#include "epollserialloop.h"
+#include <QDebug>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+EpollSerialLoop *EpollSerialLoop::instance() {
+    // owned by the thread that first uses it, like the QTimers of its links
+    static thread_local EpollSerialLoop *loop = nullptr;
+    if (loop == nullptr) {
+        loop = new EpollSerialLoop();
+    }
+    return loop;
+}
+
+EpollSerialLoop::EpollSerialLoop(QObject *parent) : QObject(parent) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        qDebug() << "epoll_create1 failed:" << strerror(errno);
+        return;
+    }
+    notifier = new QSocketNotifier(epoll_fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &EpollSerialLoop::processEvents);
+}
+
+EpollSerialLoop::~EpollSerialLoop() {
+    if (epoll_fd != -1) {
+        close(epoll_fd);
+    }
+}
+
+bool EpollSerialLoop::addLink(int fd, const EventCallback &callback) {
+    if (epoll_fd == -1) {
+        return false;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        qDebug() << "epoll_ctl add failed:" << strerror(errno);
+        return false;
+    }
+    links.insert(fd, callback);
+    return true;
+}
+
+void EpollSerialLoop::removeLink(int fd) {
+    if (links.remove(fd) > 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+int EpollSerialLoop::linkCount() const {
+    return links.count();
+}
+
+//Slots
+void EpollSerialLoop::processEvents() {
+    // drain everything that is ready, the notifier fires again if more arrives later
+    int count;
+    do {
+        count = epoll_wait(epoll_fd, events, max_events, 0);
+        for (int i=0; i<count; i++) {
+            // a callback may close its own or another link, look it up every time
+            auto link = links.constFind(events[i].data.fd);
+            if (link != links.constEnd()) {
+                EventCallback callback = link.value();
+                callback(events[i].events);
+            }
+        }
+    } while (count == max_events || (count == -1 && errno == EINTR));
+}
@@ -0,0 +1,41 @@
+#ifndef EPOLLSERIALLOOP_H
+#define EPOLLSERIALLOOP_H
+
+#include <QObject>
+#include <QHash>
+#include <QSocketNotifier>
+#include <functional>
+#include <sys/epoll.h>
+
+// One epoll set per thread for every tty opened with SerialComm::EPOLL_BACKEND.
+// The event loop only watches the epoll fd, so a link costs no notifier of its own.
+// Descriptors are edge triggered, a link's callback has to read until EAGAIN.
+class EpollSerialLoop : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void(quint32 events)> EventCallback;
+
+    static EpollSerialLoop *instance();
+
+    bool addLink(int fd, const EventCallback &callback);
+    void removeLink(int fd);
+    int linkCount() const;
+
+private:
+    explicit EpollSerialLoop(QObject *parent = nullptr);
+    ~EpollSerialLoop();
+
+    static const int max_events = 64;
+
+    int epoll_fd = -1;
+    QSocketNotifier *notifier = nullptr;
+    QHash<int, EventCallback> links;
+    struct epoll_event events[max_events];
+
+private slots:
+    void processEvents();
+};
+
+#endif // EPOLLSERIALLOOP_H
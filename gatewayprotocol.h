@@ -0,0 +1,88 @@
+#ifndef GATEWAYPROTOCOL_H
+#define GATEWAYPROTOCOL_H
+
+#include <QByteArray>
+#include <QtEndian>
+#include <string.h>
+
+// Envelope shared by OvenGateway and SerialComm::TCP_BACKEND. The oven frames are
+// carried unchanged, the envelope only adds what is needed to multiplex them:
+//
+//   request  [u32 tag][u8 oven][u8 priority][u8 length][frame]   *CCDDDDss\r
+//   response [u32 tag][u8 status][u8 length][frame]              *DDDDss^
+//
+// Integers are big endian. The tag is chosen by the client and echoed back, so a
+// client may have any number of requests outstanding and match replies as they come.
+// status is a QSerialPort::SerialPortError, the frame is empty unless it is NoError.
+namespace GatewayProtocol {
+
+const quint16 default_port = 47100;
+const int request_header = 7;
+const int response_header = 6;
+
+// The gateway answers every request within request_deadline_ms, with TimeoutError if
+// the oven has not by then, so time spent in its queue never runs out the client's
+// timeout. The client waits a little longer and only retries when the gateway itself
+// stays silent, at most client_max_attempts times.
+const int request_deadline_ms = 2000;
+const int client_timeout_ms = 3000;
+const int client_max_attempts = 3;
+
+// out must hold request_header + 255 bytes, returns the message length
+inline int encodeRequest(char *out, quint32 tag, quint8 oven, quint8 priority, const char *frame, int length) {
+    qToBigEndian(tag, out);
+    out[4] = (char)oven;
+    out[5] = (char)priority;
+    out[6] = (char)length;
+    memcpy(out + request_header, frame, length);
+    return request_header + length;
+}
+
+inline QByteArray encodeResponse(quint32 tag, quint8 status, const QByteArray &frame) {
+    QByteArray message(response_header, Qt::Uninitialized);
+    qToBigEndian(tag, message.data());
+    message[4] = (char)status;
+    message[5] = (char)frame.length();
+    return message + frame;
+}
+
+// Parse one message at offset, which is advanced past it. False if it is not all there yet.
+inline bool decodeRequest(const QByteArray &buffer, int &offset, quint32 &tag, quint8 &oven,
+                          quint8 &priority, QByteArray &frame) {
+    if (buffer.length() - offset < request_header) {
+        return false;
+    }
+    const char *header = buffer.constData() + offset;
+    const int length = (quint8)header[6];
+    if (buffer.length() - offset < request_header + length) {
+        return false;
+    }
+    tag = qFromBigEndian<quint32>(header);
+    oven = (quint8)header[4];
+    priority = (quint8)header[5];
+    frame = buffer.mid(offset + request_header, length);
+    offset += request_header + length;
+    return true;
+}
+
+// frame points into buffer, nothing is copied
+inline bool decodeResponse(const char *buffer, int buffered, int &offset, quint32 &tag, quint8 &status,
+                           const char *&frame, int &frame_length) {
+    if (buffered - offset < response_header) {
+        return false;
+    }
+    const char *header = buffer + offset;
+    frame_length = (quint8)header[5];
+    if (buffered - offset < response_header + frame_length) {
+        return false;
+    }
+    tag = qFromBigEndian<quint32>(header);
+    status = (quint8)header[4];
+    frame = header + response_header;
+    offset += response_header + frame_length;
+    return true;
+}
+
+}
+
+#endif // GATEWAYPROTOCOL_H
@@ -0,0 +1,177 @@
+#include "latencytrace.h"
+#include "ovenprotocol.h"
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <atomic>
+
+namespace {
+
+struct Entry {
+    quint32 trace_id = 0;
+    qint16 link = 0;
+    qint16 command = 0;
+    bool ok = false;
+    qint64 ns[LatencyTrace::STAGE_COUNT] = {};
+};
+
+struct Mark {
+    quint32 trace_id = 0;
+    int stage = 0;
+    qint64 ns = 0;
+};
+
+// what the span ending at each stage is called, the time since the stage before
+const char *const span_names[LatencyTrace::STAGE_COUNT] = {
+    "", "queue wait", "write", "turnaround", "reply", "decode", "display"
+};
+
+std::atomic<bool> enabled(false);
+std::atomic<quint32> last_trace_id(0);
+std::atomic<quint32> entries_written(0);
+std::atomic<quint32> marks_written(0);
+QVector<Entry> entries;
+QVector<Mark> marks;
+
+QByteArray microseconds(qint64 ns) {
+    return QByteArray::number((double)ns / 1000.0, 'f', 3);
+}
+
+QByteArray commandName(int command) {
+    const ProtocolCommand *entry = OvenCodec::command(command);
+    return entry ? QByteArray(entry->name) : "command " + QByteArray::number(command);
+}
+
+void appendSpan(QByteArray &out, const QByteArray &name, const char *category, int link,
+                qint64 start_ns, qint64 end_ns, const QByteArray &args) {
+    out += ",\n{\"name\":\"" + name + "\",\"cat\":\"" + category + "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            + QByteArray::number(link) + ",\"ts\":" + microseconds(start_ns)
+            + ",\"dur\":" + microseconds(end_ns - start_ns) + ",\"args\":{" + args + "}}";
+}
+
+}
+
+namespace LatencyTrace {
+
+void enable(int capacity) {
+    // resized only here, so record() never allocates
+    if (entries.size() != capacity) {
+        disable();
+        entries = QVector<Entry>(capacity);
+        marks = QVector<Mark>(capacity);
+        clear();
+    }
+    enabled = capacity > 0;
+}
+
+void disable() {
+    enabled = false;
+}
+
+bool isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void clear() {
+    entries_written = 0;
+    marks_written = 0;
+}
+
+quint32 nextId() {
+    if (!isEnabled()) {
+        return 0;
+    }
+    quint32 id = ++last_trace_id;
+    return id != 0 ? id : ++last_trace_id;
+}
+
+void record(int link, int command, bool ok, const SerialComm::FrameTimes &times) {
+    if (times.trace_id == 0 || !isEnabled()) {
+        return;
+    }
+    Entry &entry = entries[entries_written++ % entries.size()];
+    entry.trace_id = times.trace_id;
+    entry.link = link;
+    entry.command = command;
+    entry.ok = ok;
+    entry.ns[ENQUEUED] = times.enqueued_ns;
+    entry.ns[DEQUEUED] = times.dequeued_ns;
+    entry.ns[WRITTEN] = times.sent_ns;
+    entry.ns[FIRST_BYTE] = times.first_byte_ns;
+    entry.ns[FRAME_COMPLETE] = times.last_byte_ns;
+    entry.ns[DECODED] = times.decoded_ns;
+    entry.ns[DISPLAYED] = 0;
+}
+
+void mark(quint32 trace_id, int stage, qint64 ns) {
+    if (trace_id == 0 || !isEnabled()) {
+        return;
+    }
+    Mark &mark = marks[marks_written++ % marks.size()];
+    mark.trace_id = trace_id;
+    mark.stage = stage;
+    mark.ns = ns ? ns : SerialComm::monotonicNs();
+}
+
+int count() {
+    return (int)qMin<quint32>(entries_written, entries.size());
+}
+
+bool exportChromeTrace(const QString &file_name) {
+    QFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    // later stages by trace id, the first mark of a stage wins
+    QHash<quint64, qint64> marked;
+    const quint32 mark_count = qMin<quint32>(marks_written, marks.size());
+    for (quint32 i=marks_written-mark_count; i!=marks_written; i++) {
+        const Mark &mark = marks[i % marks.size()];
+        const quint64 key = ((quint64)mark.trace_id << 8) | mark.stage;
+        if (!marked.contains(key)) {
+            marked.insert(key, mark.ns);
+        }
+    }
+
+    QByteArray out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"OvenComm\"}}";
+    QList<int> links;
+    const quint32 entry_count = count();
+    for (quint32 i=entries_written-entry_count; i!=entries_written; i++) {
+        Entry entry = entries[i % entries.size()];
+        for (int stage=DEQUEUED; stage<STAGE_COUNT; stage++) {
+            entry.ns[stage] = marked.value(((quint64)entry.trace_id << 8) | stage, entry.ns[stage]);
+        }
+        if (!links.contains(entry.link)) {
+            links.append(entry.link);
+        }
+
+        const QByteArray args = "\"trace\":" + QByteArray::number(entry.trace_id)
+                + ",\"ok\":" + (entry.ok ? "true" : "false");
+        // stages not reached (a timeout, a write that failed) are left out of the spans
+        int reached[STAGE_COUNT];
+        int reached_count = 0;
+        reached[reached_count++] = ENQUEUED;
+        for (int stage=DEQUEUED; stage<STAGE_COUNT; stage++) {
+            if (entry.ns[stage] != 0 && entry.ns[stage] >= entry.ns[reached[reached_count-1]]) {
+                reached[reached_count++] = stage;
+            }
+        }
+        // the enclosing span first, the viewer nests what follows inside it
+        appendSpan(out, commandName(entry.command), "request", entry.link, entry.ns[ENQUEUED],
+                   entry.ns[reached[reached_count-1]], args);
+        for (int j=1; j<reached_count; j++) {
+            appendSpan(out, span_names[reached[j]], "stage", entry.link, entry.ns[reached[j-1]],
+                       entry.ns[reached[j]], args);
+        }
+    }
+    for (int link : links) {
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(link)
+                + ",\"args\":{\"name\":\"link " + QByteArray::number(link) + "\"}}";
+    }
+    out += "\n]}\n";
+    return file.write(out) == out.length();
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef LATENCYTRACE_H
+#define LATENCYTRACE_H
+
+#include <QString>
+#include "serialcomm.h"
+
+// Where the time of a request goes, from the call that queued it to the value on
+// screen. Each request gets a trace id when it is queued and carries its stage times
+// in FrameTimes, one entry per request is stored when it completes, later stages
+// (the GUI display) are added with mark(). Entries go into a ring allocated by
+// enable(), recording is a few stores and never allocates, the oldest entries are
+// overwritten when it is full.
+//
+// exportChromeTrace() writes the Chrome trace event format, open it in
+// chrome://tracing or https://ui.perfetto.dev. Each link is a thread, each request a
+// span with its stages nested under it.
+namespace LatencyTrace {
+
+enum stages { ENQUEUED=0, DEQUEUED, WRITTEN, FIRST_BYTE, FRAME_COMPLETE, DECODED, DISPLAYED, STAGE_COUNT };
+
+void enable(int capacity = 16384);
+void disable(); // keeps what was recorded for export
+bool isEnabled();
+void clear();
+
+quint32 nextId(); // 0 while disabled, so untraced requests cost one check
+void record(int link, int command, bool ok, const SerialComm::FrameTimes &times);
+void mark(quint32 trace_id, int stage, qint64 ns = 0); // ns 0 is now
+
+int count(); // entries held
+bool exportChromeTrace(const QString &file_name);
+
+}
+
+#endif // LATENCYTRACE_H
@@ -0,0 +1,171 @@
+#include "linkprobe.h"
+#include <QDebug>
+
+LinkProbe::LinkProbe(QObject *parent) : QObject(parent) {
+    connect(&probe_oven, &OvenComm::returnData, this, &LinkProbe::sampleReceived);
+    connect(&probe_oven, &OvenComm::errorSignal, this, &LinkProbe::sampleFailed);
+    connect(&rate_deadline, &QTimer::timeout, this, &LinkProbe::finishRate);
+    rate_deadline.setSingleShot(true);
+
+    // back-to-back samples, the pacing delay is not part of what we measure
+    probe_oven.setSendInterval(5);
+    probe_oven.setCacheMaxAge(0);
+}
+
+void LinkProbe::start(const SettingsDialog::Settings &settings, const QList<qint32> &baud_rates, int samples) {
+    stop();
+    comparing_latency = false;
+    for (qint32 baud_rate : baud_rates) {
+        SettingsDialog::Settings candidate = settings;
+        candidate.baudRate = baud_rate;
+        candidates.append(candidate);
+    }
+    samples_per_rate = samples;
+    results.clear();
+    probeNextRate();
+}
+
+void LinkProbe::compareLowLatency(const SettingsDialog::Settings &settings, int samples) {
+    // each run leaves the adapter as it found it, the tuned one through the link's own
+    // restore on close
+    stop();
+    comparing_latency = true;
+    SettingsDialog::Settings candidate = settings;
+    candidate.lowLatency = false;
+    candidates.append(candidate);
+    candidate.lowLatency = true;
+    candidates.append(candidate);
+    samples_per_rate = samples;
+    results.clear();
+    probeNextRate();
+}
+
+void LinkProbe::stop() {
+    rate_deadline.stop();
+    candidates.clear();
+    if (probe_oven.isOpen()) {
+        restoreTuning();
+        probe_oven.closeSerialPort();
+    }
+}
+
+bool LinkProbe::isRunning() const {
+    return rate_deadline.isActive();
+}
+
+int LinkProbe::bestResult(const QList<Result> &results) {
+    // fastest round trip among the rates that answered every sample
+    int best = -1;
+    for (int i=0; i<results.length(); i++) {
+        const Result &result = results[i];
+        if (result.replies == 0 || result.errors > 0) {
+            continue;
+        }
+        if (best == -1 || result.mean_round_trip_ms < results[best].mean_round_trip_ms) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+//Private
+void LinkProbe::probeNextRate() {
+    if (candidates.isEmpty()) {
+        emit probeFinished(results, bestResult(results));
+        return;
+    }
+
+    SettingsDialog::Settings settings = candidates.takeFirst();
+    current = Result();
+    current.baud_rate = settings.baudRate;
+    current.low_latency = settings.lowLatency;
+    round_trip_sum_us = 0;
+    emit probeProgress(current.baud_rate);
+
+    probe_oven.updateSerialInfo(settings);
+    probe_oven.openSerialPort();
+    if (!probe_oven.isOpen()) {
+        current.errors = samples_per_rate;
+        results.append(current);
+        probeNextRate();
+        return;
+    }
+    if (comparing_latency && !settings.lowLatency) {
+        // measure from the driver defaults, not from whatever an earlier session left
+        // behind, finishRate puts back what was found
+        original_tuning = SerialComm::LatencyTuning();
+        if (!probe_oven.readLatencyTuning(original_tuning)) {
+            qDebug() << "probe could not read every driver setting";
+        }
+        tuning_read = true;
+        SerialComm::LatencyTuning untuned;
+        untuned.vmin = original_tuning.vmin; // set by the open, not left over
+        untuned.vtime = original_tuning.vtime;
+        probe_oven.applyLatencyTuning(untuned);
+    }
+
+    // a wrong rate may never answer, so each rate gets a hard time budget
+    rate_deadline.start(samples_per_rate * 1000 + 500);
+    sendSample();
+}
+
+void LinkProbe::finishRate() {
+    rate_deadline.stop();
+    restoreTuning();
+    probe_oven.closeSerialPort();
+
+    int missing = samples_per_rate - current.replies - current.errors;
+    if (missing > 0) {
+        current.errors += missing;
+    }
+    if (current.replies > 0) {
+        current.mean_round_trip_ms = (double)round_trip_sum_us / current.replies / 1000.0;
+    }
+    qDebug() << "probe" << current.baud_rate << "low latency" << current.low_latency << "replies" << current.replies
+             << "errors" << current.errors << "rtt ms" << current.mean_round_trip_ms;
+
+    results.append(current);
+    probeNextRate();
+}
+
+void LinkProbe::restoreTuning() {
+    if (tuning_read) {
+        probe_oven.applyLatencyTuning(original_tuning);
+        tuning_read = false;
+    }
+}
+
+void LinkProbe::sendSample() {
+    if (current.replies + current.errors >= samples_per_rate) {
+        finishRate();
+        return;
+    }
+    probe_oven.getTemp();
+}
+
+//Slots
+void LinkProbe::sampleReceived(int value, int command_sent) {
+    Q_UNUSED(value);
+    if (command_sent != OvenComm::GETTEMP || !rate_deadline.isActive()) {
+        return;
+    }
+    current.replies++;
+    round_trip_sum_us += probe_oven.lastRoundTripUs();
+    sendSample();
+}
+
+void LinkProbe::sampleFailed(QSerialPort::SerialPortError error, QString error_string, int command_sent) {
+    Q_UNUSED(error_string);
+    Q_UNUSED(command_sent);
+    if (!rate_deadline.isActive()) {
+        return;
+    }
+    current.errors++;
+    if (error == QSerialPort::ResourceError) {
+        finishRate();
+        return;
+    }
+    // errors stop the send timer, keep sampling
+    probe_oven.startSendMessageTimer();
+    sendSample();
+}
@@ -0,0 +1,62 @@
+#ifndef LINKPROBE_H
+#define LINKPROBE_H
+
+#include <QObject>
+#include <QList>
+#include <QTimer>
+#include "ovencomm.h"
+#include "settingsdialog.h"
+
+// Tries candidate serial settings against the controller with a harmless GETTEMP
+// and reports round trip time and error rate for each one.
+class LinkProbe : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result {
+        qint32 baud_rate = 0;
+        bool low_latency = false;
+        int replies = 0;
+        int errors = 0;
+        double mean_round_trip_ms = 0.0;
+    };
+
+    explicit LinkProbe(QObject *parent = nullptr);
+
+    void start(const SettingsDialog::Settings &settings, const QList<qint32> &baud_rates, int samples = 10);
+    void compareLowLatency(const SettingsDialog::Settings &settings, int samples = 10);
+    void stop();
+    bool isRunning() const;
+
+    static int bestResult(const QList<Result> &results);
+
+signals:
+    void probeProgress(qint32 baud_rate);
+    void probeFinished(QList<LinkProbe::Result> results, int best_index);
+
+private:
+    void probeNextRate();
+    void finishRate();
+    void restoreTuning(); // the adapter settings found before the untuned run
+    void sendSample();
+
+    OvenComm probe_oven;
+    QList<SettingsDialog::Settings> candidates;
+    QList<Result> results;
+    Result current;
+    qint64 round_trip_sum_us = 0;
+    int samples_per_rate = 10;
+    bool comparing_latency = false;
+    SerialComm::LatencyTuning original_tuning;
+    bool tuning_read = false;
+    QTimer rate_deadline;
+
+private slots:
+    void sampleReceived(int value, int command_sent);
+    void sampleFailed(QSerialPort::SerialPortError error, QString error_string, int command_sent);
+};
+
+Q_DECLARE_METATYPE(LinkProbe::Result)
+
+#endif // LINKPROBE_H
@@ -52,11 +52,40 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include "gatewayprotocol.h"
+#include "latencytrace.h"
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    // QSettings location for the saved oven profiles
+    QCoreApplication::setOrganizationName("OvenComm");
+    QCoreApplication::setApplicationName("OvenCommTest");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption gateway_option("gateway", "Share the connected ovens with other hosts on <port>.",
+                                      "port", QString::number(GatewayProtocol::default_port));
+    parser.addOption(gateway_option);
+    QCommandLineOption http_option("http", "Serve live telemetry to browser dashboards on <port>.",
+                                   "port", "8080");
+    parser.addOption(http_option);
+    QCommandLineOption trace_option("trace", "Trace request latency, written to <file> on exit as Chrome trace JSON.",
+                                    "file");
+    parser.addOption(trace_option);
+    parser.process(a);
+    if (parser.isSet(trace_option))
+        LatencyTrace::enable();
+
     MainWindow w;
+    if (parser.isSet(gateway_option))
+        w.startGateway(parser.value(gateway_option).toUShort());
+    if (parser.isSet(http_option))
+        w.startTelemetryServer(parser.value(http_option).toUShort());
     w.show();
-    return a.exec();
+    const int result = a.exec();
+    if (parser.isSet(trace_option) && !LatencyTrace::exportChromeTrace(parser.value(trace_option)))
+        qWarning() << "Could not write the latency trace to" << parser.value(trace_option);
+    return result;
 }
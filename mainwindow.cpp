@@ -54,7 +54,12 @@
 #include "console.h"
 #include "settingsdialog.h"
 #include "ovencomm.h"
+#include "latencytrace.h"
+#include "ovenprofile.h"
+#include "ovenstation.h"
+#include "portenumerator.h"
 
+#include <QFileDialog>
 #include <QLabel>
 #include <QMessageBox>
 #include <QString>
@@ -71,6 +76,7 @@ MainWindow::MainWindow(QWidget *parent) :
 {
 
     m_ui->setupUi(this);
+    m_settings->setActiveLink(o_serial);
     m_ui->actionConnect->setEnabled(true);
     m_ui->actionDisconnect->setEnabled(false);
     m_ui->actionQuit->setEnabled(true);
@@ -82,10 +88,29 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(o_serial, &OvenComm::errorSignal, this, &MainWindow::handleError);
     connect(o_serial, &OvenComm::rawDataSignal, this, &MainWindow::displayRawData);
     connect(o_serial, &OvenComm::returnData, this, &MainWindow::displayData);
+    connect(o_serial, &OvenComm::returnSnapshot, this, &MainWindow::displaySnapshot);
+
+    m_recorder = new TelemetryRecorder(o_serial, 0, this);
+
+    // saved ovens come back without going through the settings dialog
+    m_station = new OvenStation(this);
+    connect(m_station, &OvenStation::ovenConnected, this, &MainWindow::ovenConnected);
+    connect(m_station, &OvenStation::ovenReconciled, this, &MainWindow::ovenReconciled);
+    connect(m_settings, &SettingsDialog::settingsApplied, this, &MainWindow::saveProfile);
+    m_station->loadProfiles(o_serial);
+    for (const OvenProfile &profile : OvenProfile::load()) {
+        if (profile.oven_id == 0)
+            m_settings->setSettings(profile.settings);
+    }
+    m_station->setRecorder(0, m_recorder);
+    m_station->enableCheckpoints();
+    m_station->connectAll();
 }
 
 MainWindow::~MainWindow()
 {
+    // the last checkpoint needs the oven and a recorder that is still recording
+    delete m_station;
     delete m_settings;
     delete m_ui;
 }
@@ -147,6 +172,10 @@ void MainWindow::initActionsConnections()
 {
     connect(m_ui->actionConnect, &QAction::triggered, this, &MainWindow::openSerialPort);
     connect(m_ui->actionDisconnect, &QAction::triggered, this, &MainWindow::closeSerialPort);
+    connect(m_ui->actionDisconnect, &QAction::triggered, this, [this]() {
+        // the operator wants it closed, do not bring it back on the next hot-plug event
+        m_station->setAutoConnect(0, false);
+    });
     connect(m_ui->actionQuit, &QAction::triggered, this, &MainWindow::close);
     connect(m_ui->actionConfigure, &QAction::triggered, m_settings, &SettingsDialog::show);
     connect(m_ui->actionClear, &QAction::triggered, m_console, &Console::clear);
@@ -161,13 +190,12 @@ void MainWindow::showStatusMessage(const QString &message)
     m_status->setText(message);
 }
 
-void MainWindow::displayData(QString data, int command_sent) {
+void MainWindow::displayData(int int_data, int command_sent, SerialComm::FrameTimes times) {
     OvenComm::commands command = (OvenComm::commands)command_sent;
-    qDebug() << data << command;
-    int int_data = data.toInt();
+    qDebug() << int_data << command;
     switch(command) {
         case OvenComm::GETOUTPUT:
-            m_ui->lcdNumberSensorStatus->display((double)int_data / 28800.0);
+            m_ui->lcdNumberOutput->display((double)int_data / 28800.0);
             break;
         case OvenComm::GETTEMP:
             m_ui->lcdNumberCurrentTemp->display((double)int_data / 100.0);
@@ -182,6 +210,16 @@ void MainWindow::displayData(QString data, int command_sent) {
             m_ui->lcdNumberSensorStatus->display((bool)int_data);
             break;
     }
+    // the LCD repaints on the next pass of the event loop, this is the last stage we see
+    LatencyTrace::mark(times.trace_id, LatencyTrace::DISPLAYED);
+}
+
+void MainWindow::displaySnapshot(OvenComm::Snapshot snapshot) {
+    m_ui->lcdNumberCurrentTemp->display(snapshot.temp);
+    m_ui->lcdNumberSetTemp->display(snapshot.set_temp);
+    m_ui->lcdNumberOutput->display(snapshot.output);
+    m_ui->lcdNumberSensorStatus->display(snapshot.sensor_status);
+    m_ui->lcdNumberPowerStatus->display(snapshot.power_status);
 }
 
 void MainWindow::on_pushButtonSetTemp_clicked()
@@ -219,11 +257,89 @@ void MainWindow::on_pushButtonReadPowerStatus_clicked() {
     o_serial->getPowerStatus();
 }
 
+void MainWindow::on_pushButtonReadOutput_clicked() {
+    o_serial->getOutput();
+}
+
 void MainWindow::on_pushButtonSetPowerStatus_clicked() {
     o_serial->setPowerStatus(m_ui->spinBoxPowerStatus->value());
 }
 
+void MainWindow::on_pushButtonReadSnapshot_clicked() {
+    o_serial->getSnapshot();
+}
+
 void MainWindow::on_pushButtonStartMessageTimer_clicked() {
     o_serial->startSendMessageTimer();
 }
 
+void MainWindow::saveProfile() {
+    const OvenProfile profile = OvenProfile::fromSettings(0, m_settings->settings(),
+                                                          PortEnumerator::instance()->ports());
+    OvenProfile::store(profile);
+    if (m_station->oven(0))
+        m_station->updateProfile(profile);
+    else {
+        m_station->addOven(profile, o_serial);
+        m_station->setRecorder(0, m_recorder);
+    }
+}
+
+void MainWindow::ovenConnected(quint16 oven_id, QString port_name) {
+    if (oven_id != 0) {
+        return;
+    }
+    m_ui->actionConnect->setEnabled(false);
+    m_ui->actionDisconnect->setEnabled(true);
+    m_ui->actionConfigure->setEnabled(false);
+    showStatusMessage(tr("Connected to %1").arg(port_name));
+}
+
+void MainWindow::startGateway(quint16 port) {
+    if (m_station->startGateway(port)) {
+        showStatusMessage(tr("Sharing ovens on localhost port %1").arg(port));
+    } else {
+        QMessageBox::warning(this, tr("Warning"), tr("Could not start the oven gateway on port %1").arg(port));
+    }
+}
+
+void MainWindow::startTelemetryServer(quint16 port) {
+    if (m_station->startTelemetryServer(port)) {
+        showStatusMessage(tr("Live telemetry on http://localhost:%1/api/stream").arg(port));
+    } else {
+        QMessageBox::warning(this, tr("Warning"), tr("Could not start the telemetry server on port %1").arg(port));
+    }
+}
+
+void MainWindow::ovenReconciled(quint16 oven_id, bool setpoint_resent, bool power_matches) {
+    if (oven_id != 0) {
+        return;
+    }
+    m_ui->actionRecordTelemetry->setChecked(m_recorder->isRecording());
+    if (!power_matches) {
+        QMessageBox::warning(this, tr("Warning"),
+                             tr("Oven power status differs from before the restart, it was not changed."));
+    } else if (setpoint_resent) {
+        showStatusMessage(tr("Restored setpoint sent to oven"));
+    }
+}
+
+void MainWindow::on_actionRecordTelemetry_triggered(bool checked) {
+    if (!checked) {
+        m_recorder->stop();
+        showStatusMessage(tr("Telemetry recording stopped"));
+        return;
+    }
+
+    QString file_name = QFileDialog::getSaveFileName(this, tr("Record Telemetry"), QString(),
+                                                     tr("Telemetry archive (*.ovta)"));
+    if (file_name.isEmpty()) {
+        m_ui->actionRecordTelemetry->setChecked(false);
+    } else if (!m_recorder->start(file_name)) {
+        m_ui->actionRecordTelemetry->setChecked(false);
+        QMessageBox::warning(this, tr("Warning"), m_recorder->errorString());
+    } else {
+        showStatusMessage(tr("Recording telemetry to %1").arg(file_name));
+    }
+}
+
@@ -57,6 +57,7 @@
 #include <QObject>
 #include <QDebug>
 #include "ovencomm.h"
+#include "telemetryrecorder.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -70,6 +71,7 @@ QT_END_NAMESPACE
 
 class Console;
 class SettingsDialog;
+class OvenStation;
 
 class MainWindow : public QMainWindow
 {
@@ -79,6 +81,9 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    void startGateway(quint16 port);
+    void startTelemetryServer(quint16 port);
+
 private slots:
     void openSerialPort();
     void closeSerialPort();
@@ -97,10 +102,20 @@ private slots:
 
     void on_pushButtonReadSensorStatus_clicked();
     void on_pushButtonReadPowerStatus_clicked();
+    void on_pushButtonReadOutput_clicked();
 
     void on_pushButtonSetPowerStatus_clicked();
 
-    void displayData(QString data, int command_sent);
+    void displayData(int value, int command_sent, SerialComm::FrameTimes times);
+    void displaySnapshot(OvenComm::Snapshot snapshot);
+
+    void on_pushButtonReadSnapshot_clicked();
+
+    void on_actionRecordTelemetry_triggered(bool checked);
+
+    void saveProfile();
+    void ovenConnected(quint16 oven_id, QString port_name);
+    void ovenReconciled(quint16 oven_id, bool setpoint_resent, bool power_matches);
 
 private:
     void initActionsConnections();
@@ -114,6 +129,8 @@ private:
     Console *m_console = nullptr;
     SettingsDialog *m_settings = nullptr;
     OvenComm *o_serial = nullptr;
+    TelemetryRecorder *m_recorder = nullptr;
+    OvenStation *m_station = nullptr;
 };
 
 #endif // MAINWINDOW_H
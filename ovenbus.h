@@ -0,0 +1,45 @@
+#ifndef OVENBUS_H
+#define OVENBUS_H
+
+#include "ovenprotocol.h"
+#include "serialbus.h"
+
+// SerialBus with the framing of a FrameCodec, the address going after the start byte
+// of both frames, see protocoltraits.h. OvenBus<> carries oven cards, other controllers
+// share a bus as OvenBus<FrameCodec<ChillerProtocol>> with DeviceComm<ChillerProtocol>
+// links.
+template <typename Codec = OvenCodec>
+class OvenBus : public SerialBus
+{
+public:
+    static_assert(Codec::addressed_request_size <= max_frame && Codec::addressed_reply_size <= max_frame,
+                  "frames must fit the bus buffers");
+    static_assert((int)Codec::VALID == VALID && (int)Codec::BAD_CHECKSUM == BAD_CHECKSUM
+                  && (int)Codec::INCOMPLETE == INCOMPLETE && (int)Codec::MALFORMED == MALFORMED,
+                  "codec results must match SerialBus::results");
+
+    explicit OvenBus(QObject *parent = nullptr) : SerialBus(parent) {}
+
+protected:
+    int encodeRequest(int address, int command, int value, char *out) const override {
+        return Codec::encodeAddressedRequest(address, command, value, out);
+    }
+
+    int decodeReply(const char *data, int length, int &address, int &value) const override {
+        return Codec::decodeAddressedReply(data, qMin(length, Codec::addressed_reply_size), address, value);
+    }
+
+    int encodeLinkReply(int value, char *out) const override {
+        return Codec::encodeReply(value, out);
+    }
+
+    int replySize() const override {
+        return Codec::addressed_reply_size;
+    }
+
+    char replyStart() const override {
+        return Codec::reply_start;
+    }
+};
+
+#endif // OVENBUS_H
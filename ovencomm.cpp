@@ -2,144 +2,419 @@
 #include <QSerialPort>
 #include <QDebug>
 #include "settingsdialog.h"
-#include <QRegExp>
 #include <QTimer>
 #include <QThread>
+#include <QDateTime>
 
 OvenComm::OvenComm(QObject *parent) : SerialComm(parent) {
     connect(&serial_conn, &QSerialPort::readyRead, this, &OvenComm::serialConnReceiveMessage);
-    connect(&send_message_timer, &QTimer::timeout, this, &OvenComm::sendMessage);
+    send_message_timer.setCallback([this]() { sendMessage(); });
+    qRegisterMetaType<AlarmEngine::Alarm>();
+    interlock_timer.setCallback([this]() { interlockTimeout(); });
+    interlock_timer.setSingleShot(true);
 }
 
-void OvenComm::setTemp(double temp) {
-    if (isOpen()) {
-        command_queue.enqueue(SETTEMP);
-        data_queue.enqueue(QString::number((int)(temp*100.0)));
+void OvenComm::setTemp(double temp, int priority, const ReplyCallback &callback) {
+    if (!OvenCodec::fitsData(temp * OvenCodec::scale(SETTEMP))) {
+        // the data field would wrap, e.g. 700 degrees goes out as 44.64
+        emit errorSignal(QSerialPort::UnsupportedOperationError,
+                         QString("Setpoint %1 is out of range").arg(temp), SETTEMP);
+        failRequest(callback, SETTEMP, QSerialPort::UnsupportedOperationError);
+    } else if (isOpen()) {
+        int value = qRound(temp * OvenCodec::scale(SETTEMP));
+        if (isCacheFresh(GETSETTEMP) && state_cache[GETSETTEMP].value == value
+                && !hasPendingRequest(SETTEMP)) {
+            // controller already holds this setpoint
+            returnCachedData(GETSETTEMP, SETTEMP, callback);
+        } else {
+            enqueueLatest(SETTEMP, value, priority, callback);
+        }
     } else {
         sendError(QSerialPort::NotOpenError, "No open connection");
+        failRequest(callback, SETTEMP, QSerialPort::NotOpenError);
     }
 }
 
 
-void OvenComm::getTemp() {
+void OvenComm::getTemp(int priority, const ReplyCallback &callback) {
     if (isOpen()) {
-        command_queue.enqueue(GETTEMP);
-        data_queue.enqueue(0);
+        enqueueRequest(GETTEMP, 0, priority, callback);
     } else {
         sendError(QSerialPort::NotOpenError, "No open connection");
+        failRequest(callback, GETTEMP, QSerialPort::NotOpenError);
     }
 }
 
 
-void OvenComm::getSetTemp() {
+void OvenComm::getSetTemp(int priority, const ReplyCallback &callback) {
     if (isOpen()) {
-        command_queue.enqueue(GETSETTEMP);
-        data_queue.enqueue(0);
+        if (isCacheFresh(GETSETTEMP) && !hasPendingRequest(SETTEMP)) {
+            returnCachedData(GETSETTEMP, GETSETTEMP, callback);
+            return;
+        }
+        enqueueRequest(GETSETTEMP, 0, priority, callback);
     } else {
         sendError(QSerialPort::NotOpenError, "No open connection");
+        failRequest(callback, GETSETTEMP, QSerialPort::NotOpenError);
     }
 }
 
 
-void OvenComm::getOutput() {
+void OvenComm::getOutput(int priority, const ReplyCallback &callback) {
     if (isOpen()) {
-        command_queue.enqueue(GETOUTPUT);
-        data_queue.enqueue(0);
+        enqueueRequest(GETOUTPUT, 0, priority, callback);
     } else {
         sendError(QSerialPort::NotOpenError, "No open connection");
+        failRequest(callback, GETOUTPUT, QSerialPort::NotOpenError);
     }
 }
 
 
-void OvenComm::getSensorStatus() {
+void OvenComm::getSensorStatus(int priority, const ReplyCallback &callback) {
     if (isOpen()) {
-        command_queue.enqueue(GETSENSORSTATUS);
-        data_queue.enqueue(0);
+        enqueueRequest(GETSENSORSTATUS, 0, priority, callback);
     } else {
         sendError(QSerialPort::NotOpenError, "No open connection");
+        failRequest(callback, GETSENSORSTATUS, QSerialPort::NotOpenError);
     }
 }
 
 
-void OvenComm::setPowerStatus(bool on) {
+void OvenComm::setPowerStatus(bool on, const ReplyCallback &callback) {
     if (isOpen()) {
-        command_queue.enqueue(SETPOWERSTATUS);
-        data_queue.enqueue(QString::number((int)on));
+        // turning the oven off must never wait behind queued reads, and is never skipped
+        if (on && isCacheFresh(GETPOWERSTATUS) && state_cache[GETPOWERSTATUS].value == 1
+                && !hasPendingRequest(SETPOWERSTATUS)) {
+            returnCachedData(GETPOWERSTATUS, SETPOWERSTATUS, callback);
+        } else {
+            enqueueLatest(SETPOWERSTATUS, (int)on, on ? SET : SAFETY, callback);
+        }
     } else {
         sendError(QSerialPort::NotOpenError, "No open connection");
+        failRequest(callback, SETPOWERSTATUS, QSerialPort::NotOpenError);
     }
 }
 
 
-void OvenComm::getPowerStatus() {
+void OvenComm::getPowerStatus(int priority, const ReplyCallback &callback) {
     if (isOpen()) {
-        command_queue.enqueue(GETPOWERSTATUS);
-        data_queue.enqueue(0);
+        if (isCacheFresh(GETPOWERSTATUS) && !hasPendingRequest(SETPOWERSTATUS)) {
+            returnCachedData(GETPOWERSTATUS, GETPOWERSTATUS, callback);
+            return;
+        }
+        enqueueRequest(GETPOWERSTATUS, 0, priority, callback);
     } else {
         sendError(QSerialPort::NotOpenError, "No open connection");
+        failRequest(callback, GETPOWERSTATUS, QSerialPort::NotOpenError);
     }
 }
 
+void OvenComm::getSnapshot(int priority) {
+    // Queued as one group so the reads go out back-to-back, see serialConnReceiveMessage
+    static const QList<int> snapshot_commands = QList<int>() << GETTEMP << GETSETTEMP << GETOUTPUT
+                                                             << GETSENSORSTATUS << GETPOWERSTATUS;
+    if (isOpen()) {
+        enqueueGroup(snapshot_commands, priority);
+    } else {
+        sendError(QSerialPort::NotOpenError, "No open connection");
+    }
+}
+
+void OvenComm::emergencyPowerOff(qint64 trigger_ns) {
+    if (!isOpen()) {
+        sendError(QSerialPort::NotOpenError, "No open connection");
+        emit interlockFinished(false, -1, 0);
+        return;
+    }
+    if (interlock_active) {
+        return;
+    }
+    interlock_trigger_ns = trigger_ns ? trigger_ns : monotonicNs();
+    interlock_verify = request_active;
+
+    // preempt the transaction on the wire, reads are retried afterwards
+    if (request_active) {
+        stopReplyTimeout();
+        request_active = false;
+        if (current_request.command == SETPOWERSTATUS) {
+            completeRequest(current_request, false, 0, QSerialPort::OperationError);
+        } else {
+            command_queue[current_request.priority].prepend(std::move(current_request));
+        }
+    }
+    // queued power changes are superseded, a later power on must be asked for again
+    for (int i=0; i<PRIORITY_COUNT; i++) {
+        for (int j=command_queue[i].length()-1; j>=0; j--) {
+            if (command_queue[i][j].command == SETPOWERSTATUS) {
+                Request request = command_queue[i].takeAt(j);
+                completeRequest(request, false, 0, QSerialPort::OperationError);
+            }
+        }
+    }
+    state_cache.remove(GETPOWERSTATUS);
+
+    interlock_active = true;
+    interlock_attempts = 0;
+    sendInterlockFrame();
+}
+
+void OvenComm::setInterlockRetry(int timeout_ms, int max_attempts) {
+    interlock_timeout_ms = qMax(1, timeout_ms);
+    interlock_max_attempts = qMax(1, max_attempts);
+}
+
+bool OvenComm::isInterlockActive() const {
+    return interlock_active;
+}
+
+qint64 OvenComm::lastInterlockReactionUs() const {
+    return last_interlock_reaction_us;
+}
+
+void OvenComm::closeSerialPort() {
+    interlock_requested = false;
+    if (interlock_active) {
+        finishInterlock(false);
+    }
+    // whatever happens while disconnected is unknown to us
+    invalidateCache();
+    alarm_engine.reset();
+    SerialComm::closeSerialPort();
+}
+
+void OvenComm::setCacheMaxAge(int max_age_ms) {
+    cache_max_age_ms = max_age_ms;
+}
+
+OvenComm::CachedValue OvenComm::cachedValue(int command) const {
+    return state_cache.value(command);
+}
+
+void OvenComm::invalidateCache() {
+    state_cache.clear();
+}
+
+AlarmEngine &OvenComm::alarmEngine() {
+    return alarm_engine;
+}
+
 //Private
 void OvenComm::sendError(QSerialPort::SerialPortError error, const QString &error_message) {
+    if (interlock_active) {
+        // keep the power off frame in flight, interlock_timer resends it
+        if (isOpen()) {
+            clearSerialData();
+        }
+        clearReceiveBuffer();
+        emit errorSignal(error, error_message, SETPOWERSTATUS);
+        return;
+    }
+
     send_message_timer.stop();
 
     // clear serial internal read/write buffers
     if (isOpen()) {
-        serial_conn.clear();
+        clearSerialData();
     }
 
-    // Dequeue command if one is associated with the error
-    if (command_queue.isEmpty()) {
+    // Drop the in-flight command if one is associated with the error
+    if (!request_active) {
         emit errorSignal(error, error_message, commands::NONE);
     } else {
-        data_queue.dequeue();
-        temp_data = "";
-        emit errorSignal(error, error_message, command_queue.dequeue());
+        finishCurrentRequest();
+        // a failed write leaves the controller state unknown
+        if (current_request.command == SETTEMP) {
+            state_cache.remove(GETSETTEMP);
+        } else if (current_request.command == SETPOWERSTATUS) {
+            state_cache.remove(GETPOWERSTATUS);
+        }
+        if (current_request.group == GROUP_MEMBER) {
+            // A failed read invalidates the whole snapshot, discard the rest of its group
+            dropGroup(current_request.priority);
+        }
+        emit errorSignal(error, error_message, current_request.command);
+        completeRequest(current_request, false, 0, error);
     }
 }
 
-void OvenComm::serialConnSendMessage() {
-    //construct message
-    QByteArray data = QString::number(command_queue.head()).rightJustified(2, '0').toUtf8();
-    data += QString::number(data_queue.head().toInt(), 16).rightJustified(4, '0').toUtf8();
-    //calculate checksum
-    qint16 sum_of_bytes = 0;
-    for(int i=0; i<data.length(); i++) {
-        sum_of_bytes += ((QChar)data[i]).unicode();
-    }
-    data += QString::number(sum_of_bytes%256, 16).rightJustified(2, '0').toUtf8();
-    data += '\r';
-    data.prepend('*');
-
-    qDebug() << "final data:" << data;
-
-    if (serial_conn.write(data) == -1) { // -1 indicates error occurred
-        // send QSerialPort::NotOpenError if QOIDevice::NotOpen is triggered
-        if (serial_conn.error() == QSerialPort::NoError) {
-            sendError(QSerialPort::NotOpenError, "No open connection");
-        } //else UNNEEDED as the QSerialPort will emit its own signal for other errors
+void OvenComm::updateSnapshot(int command, int value) {
+    // no group in progress yet means this is the first reply of a new snapshot
+    if (group_priority == -1) {
+        pending_snapshot = Snapshot();
+        pending_snapshot.timestamp = QDateTime::currentDateTime();
+        pending_snapshot.sampled_ns = current_request.times.last_byte_ns;
+    }
+
+    switch(command) {
+        case GETTEMP:
+            pending_snapshot.temp = (double)value / OvenCodec::scale(GETTEMP);
+            break;
+        case GETSETTEMP:
+            pending_snapshot.set_temp = (double)value / OvenCodec::scale(GETSETTEMP);
+            break;
+        case GETOUTPUT:
+            pending_snapshot.output = (double)value / OvenCodec::scale(GETOUTPUT);
+            break;
+        case GETSENSORSTATUS:
+            pending_snapshot.sensor_status = (bool)value;
+            break;
+        case GETPOWERSTATUS:
+            pending_snapshot.power_status = (bool)value;
+            break;
+    }
+}
+
+void OvenComm::updateCache(int command, int value) {
+    // writes are confirmed with the value that was sent, stored under the matching read
+    const ProtocolCommand *entry = OvenCodec::command(command);
+    if (entry && entry->state != command) {
+        command = entry->state;
+        value = current_request.value;
+    }
+
+    CachedValue &cached = state_cache[command];
+    cached.value = value;
+    cached.updated_ns = current_request.times.last_byte_ns;
+    cached.valid = true;
+}
+
+void OvenComm::returnCachedData(int command, int reply_command, const ReplyCallback &callback) {
+    // nothing went on the wire, the sample time is when the value was confirmed
+    const CachedValue cached = state_cache.value(command);
+    FrameTimes times;
+    times.last_byte_ns = cached.updated_ns;
+    emit returnData(cached.value, reply_command, times);
+
+    if (callback) {
+        Reply reply;
+        reply.command = reply_command;
+        reply.ok = true;
+        reply.value = cached.value;
+        reply.times = times;
+        callback(reply);
+    }
+}
+
+bool OvenComm::isCacheFresh(int command) const {
+    if (cache_max_age_ms <= 0 || !state_cache.contains(command)) {
+        return false;
+    }
+    const CachedValue cached = state_cache.value(command);
+    return cached.valid && monotonicNs() - cached.updated_ns <= (qint64)cache_max_age_ms * 1000000;
+}
+
+void OvenComm::sendInterlockFrame() {
+    // drop anything half received, only a reply that is still on its way can get past this
+    clearSerialData();
+    clearReceiveBuffer();
+
+    current_request = Request();
+    current_request.command = SETPOWERSTATUS;
+    current_request.value = 0;
+    current_request.priority = SAFETY;
+    request_active = true;
+    interlock_reading = false;
+    interlock_attempts++;
+
+    serialConnSendMessage();
+    stopReplyTimeout(); // interlock_timer does the retrying
+    interlock_timer.start(interlock_timeout_ms);
+}
+
+void OvenComm::sendInterlockReadback() {
+    // whichever frame came in, the preempted reply is spent now
+    clearSerialData();
+    clearReceiveBuffer();
+
+    current_request = Request();
+    current_request.command = GETPOWERSTATUS;
+    current_request.priority = SAFETY;
+    request_active = true;
+    interlock_reading = true;
+
+    serialConnSendMessage();
+    stopReplyTimeout(); // interlock_timer does the retrying
+    interlock_timer.start(interlock_timeout_ms);
+}
+
+void OvenComm::interlockTimeout() {
+    if (!isOpen()) {
+        finishInterlock(false);
+    } else if (interlock_attempts < interlock_max_attempts) {
+        sendInterlockFrame();
     } else {
-        timeout_timer.start(1000);
+        finishInterlock(false);
+        emit errorSignal(QSerialPort::TimeoutError, "Interlock power off not acknowledged", SETPOWERSTATUS);
+        sendMessage();
     }
 }
 
-bool OvenComm::verifyChecksum(const QString &data, const QString &checksum) {
-    // Verify checksum matches the data received
-    qint16 sum_of_bytes = 0;
-    for (int i=0; i<data.length(); i++) {
-        sum_of_bytes += data[i].unicode();
+void OvenComm::finishInterlock(bool confirmed) {
+    interlock_timer.stop();
+    interlock_active = false;
+    interlock_verify = false;
+    interlock_reading = false;
+    request_active = false;
+    clearReceiveBuffer();
+
+    qint64 reaction_us = -1;
+    if (confirmed) {
+        reaction_us = (current_request.times.last_byte_ns - interlock_trigger_ns) / 1000;
+        last_interlock_reaction_us = reaction_us;
+    }
+    emit interlockFinished(confirmed, reaction_us, interlock_attempts);
+}
+
+void OvenComm::evaluateAlarms(int command, int value) {
+    // temps in degrees, everything else as read, see AlarmEngine
+    double scaled = value;
+    if (command == GETTEMP || command == GETSETTEMP) {
+        scaled = (double)value / OvenCodec::scale(command);
+    }
+
+    QList<AlarmEngine::Alarm> changed;
+    alarm_engine.evaluate(command, scaled, current_request.times.last_byte_ns, changed);
+    for (const AlarmEngine::Alarm &alarm : changed) {
+        // react here, a busy GUI thread must not hold up turning the oven off
+        if (alarm.active && alarm.power_off && !interlock_requested) {
+            // fired once the current reply is finished with, see serialConnReceiveMessage
+            interlock_requested = true;
+            interlock_trigger_ns = alarm.frame_ns;
+        }
+        emit alarmChanged(alarm);
+    }
+}
+
+void OvenComm::serialConnSendMessage() {
+    //construct message, every backend copies it before writeSerialData returns
+    char frame[OvenCodec::request_size];
+    const int length = OvenCodec::encodeRequest(current_request.command, current_request.value, frame);
+    const QByteArray data = QByteArray::fromRawData(frame, length);
+
+    qCDebug(serialFrames) << "final data:" << data;
+
+    if (writeSerialData(data) != -1) { // -1 indicates error occurred, already reported
+        startReplyTimeout();
     }
+}
 
-    if ((sum_of_bytes%256) != checksum.toInt(nullptr, 16)) {
+bool OvenComm::processReply(bool checksum_ok, int return_data) {
+    // Verify checksum matches the data received
+    if (!checksum_ok) {
         sendError(QSerialPort::ParityError, "Checksum mismatched");
         return false;
     }
+    current_request.times.decoded_ns = monotonicNs();
 
-    int return_data = data.toInt(nullptr, 16);
-
-    qDebug() << " read data:" << return_data;
-    emit returnData(QString::number(return_data), command_queue.head());
+    qCDebug(serialFrames) << " read data:" << return_data;
+    updateCache(current_request.command, return_data);
+    evaluateAlarms(current_request.command, return_data);
+    if (current_request.group == NO_GROUP) {
+        emit returnData(return_data, current_request.command, current_request.times);
+    } else {
+        updateSnapshot(current_request.command, return_data);
+    }
+    completeRequest(current_request, true, return_data);
     return true;
 }
 
@@ -147,22 +422,67 @@ bool OvenComm::verifyChecksum(const QString &data, const QString &checksum) {
 void OvenComm::serialConnReceiveMessage() {
     // complete data example: *01f4fb^
     // construct message from parts
-    temp_data += serial_conn.readAll();
-    QRegExp match_regex = QRegExp("^\\*([a-fA-F0-9]{4})([a-fA-F0-9]{2})\\^$");
-    if(match_regex.exactMatch(temp_data)) {
-        emit rawDataSignal(temp_data);
+    bool first_bytes = receive_length == 0;
+    if (receiveSerialData() == 0) {
+        return;
+    }
+    if (first_bytes) {
+        current_request.times.first_byte_ns = last_read_ns;
+    }
+    if (!request_active) {
+        // nothing was asked for, do not let stray bytes poison the next reply
+        clearReceiveBuffer();
+        return;
+    }
+    int return_data = 0;
+    const int result = OvenCodec::decodeReply(receive_buffer, receive_length, return_data);
+    if (result == OvenCodec::VALID || result == OvenCodec::BAD_CHECKSUM) {
+        current_request.times.last_byte_ns = last_read_ns;
+        last_round_trip_us = (current_request.times.last_byte_ns - current_request.times.sent_ns) / 1000;
+        emitRawData();
         timeout_timer.stop();
 
-        if (verifyChecksum(match_regex.cap(1), match_regex.cap(2))) {
-            temp_data = "";
-            data_queue.dequeue();
-            command_queue.dequeue();
+        if (interlock_active) {
+            if (result != OvenCodec::VALID) {
+                clearReceiveBuffer();
+            } else if (interlock_reading && return_data != 0) {
+                // the power off did not get through, resend it while attempts are left
+                interlock_timer.stop();
+                interlockTimeout();
+            } else if (!interlock_reading && interlock_verify) {
+                // may be the late answer to the preempted request rather than the ack
+                sendInterlockReadback();
+            } else {
+                updateCache(current_request.command, 0);
+                finishInterlock(true);
+                sendMessage();
+            }
+            return;
+        }
+
+        if (processReply(result == OvenCodec::VALID, return_data)) {
+            finishCurrentRequest();
+
+            if (current_request.group == GROUP_END) {
+                emit returnSnapshot(pending_snapshot);
+            }
+
+            if (interlock_requested) {
+                interlock_requested = false;
+                emergencyPowerOff(interlock_trigger_ns);
+                return;
+            }
+
+            // rest of a snapshot and safety requests go out now instead of waiting on send_message_timer
+            if (group_priority != -1 || !command_queue[SAFETY].isEmpty()) {
+                sendMessage();
+            }
         }
     }
 }
 
 void OvenComm::sendMessage() {
-    if (isOpen() && !command_queue.isEmpty() && !timeout_timer.isActive()) {
+    if (isOpen() && !interlock_active && !timeout_timer.isActive() && (request_active || takeNextRequest())) {
         serialConnSendMessage();
     }
 }
@@ -2,7 +2,11 @@
 #define OVENCOMM_H
 
 #include "serialcomm.h"
+#include "alarmengine.h"
+#include "ovenprotocol.h"
 #include "settingsdialog.h"
+#include <QDateTime>
+#include <QHash>
 
 
 class OvenComm : public SerialComm
@@ -11,32 +15,110 @@ class OvenComm : public SerialComm
 
 public:
     // enum for indicating the use of data that is read from serial for additional calulcations
-    enum commands { NONE=0, GETTEMP=1, GETSETTEMP=30, SETTEMP=60,
-                     GETOUTPUT=3, GETSENSORSTATUS=4, GETPOWERSTATUS=35, SETPOWERSTATUS=65};
+    // codes and framing are in OvenProtocol
+    enum commands { NONE=OvenProtocol::NONE, GETTEMP=OvenProtocol::GETTEMP, GETSETTEMP=OvenProtocol::GETSETTEMP,
+                    SETTEMP=OvenProtocol::SETTEMP, GETOUTPUT=OvenProtocol::GETOUTPUT,
+                    GETSENSORSTATUS=OvenProtocol::GETSENSORSTATUS, GETPOWERSTATUS=OvenProtocol::GETPOWERSTATUS,
+                    SETPOWERSTATUS=OvenProtocol::SETPOWERSTATUS};
         // type | what_its_for/calculations | range
         // double | temp  x 100 | (-32768, 32768)
         // double | output / 28800 (%) | (0, 28800)
         // bool | status | (0, 1)
+    // all values read in one getSnapshot() group, scaled like MainWindow::displayData
+    struct Snapshot {
+        double temp = 0.0;
+        double set_temp = 0.0;
+        double output = 0.0;
+        bool sensor_status = false;
+        bool power_status = false;
+        QDateTime timestamp; // time the first reply of the group arrived
+        qint64 sampled_ns = 0; // the same on SerialComm::monotonicNs()
+    };
+
+    // last value confirmed by the controller for a read command
+    struct CachedValue {
+        int value = 0;
+        qint64 updated_ns = 0; // monotonicNs() of the confirming reply
+        bool valid = false;
+    };
+
     explicit OvenComm(QObject *parent = nullptr);
 
-    void setTemp(double temp); //Done
-    void getTemp(); //Done
-    void getSetTemp(); //Done
+    // callback, when given, gets the decoded result of that one request, see SerialComm::Reply
+    // setTemp and setPowerStatus replace a write of their kind that is still queued, whose
+    // callback then gets OperationError, see SerialComm::enqueueLatest
+    void setTemp(double temp, int priority = SET, const ReplyCallback &callback = ReplyCallback()); //Done
+    void getTemp(int priority = INTERACTIVE, const ReplyCallback &callback = ReplyCallback()); //Done
+    void getSetTemp(int priority = INTERACTIVE, const ReplyCallback &callback = ReplyCallback()); //Done
+
+    void getOutput(int priority = INTERACTIVE, const ReplyCallback &callback = ReplyCallback()); //Done
+    void getSensorStatus(int priority = INTERACTIVE, const ReplyCallback &callback = ReplyCallback()); //Done
+
+    void setPowerStatus(bool on, const ReplyCallback &callback = ReplyCallback()); //Done, off is always sent as SAFETY
+    void getPowerStatus(int priority = INTERACTIVE, const ReplyCallback &callback = ReplyCallback()); //Done
+
+    void getSnapshot(int priority = INTERACTIVE);
+
+    // Safety interlock: preempts whatever is on the wire and writes SETPOWERSTATUS 0
+    // directly, resending until it is acknowledged or the attempts run out. Replies do
+    // not say which command they answer, so when a request was preempted the first
+    // reply may be its late answer; the power off is then confirmed by reading
+    // GETPOWERSTATUS back.
+    // trigger_ns is when the condition was seen, 0 for now.
+    void emergencyPowerOff(qint64 trigger_ns = 0);
+    void setInterlockRetry(int timeout_ms, int max_attempts);
+    bool isInterlockActive() const;
+    qint64 lastInterlockReactionUs() const; // trigger to acknowledged power off, -1 if none yet
 
-    void getOutput(); //Done
-    void getSensorStatus(); //Done
+    void closeSerialPort() override;
 
-    void setPowerStatus(bool on); //Done
-    void getPowerStatus(); //Done
+    void setCacheMaxAge(int max_age_ms); // 0, the default, turns off cached reads and write dedup
+    CachedValue cachedValue(int command) const;
+    void invalidateCache();
+
+    // rules and windows are evaluated on every decoded reply, before returnData goes out
+    AlarmEngine &alarmEngine();
+
+signals:
+    void returnSnapshot(OvenComm::Snapshot snapshot);
+    void alarmChanged(AlarmEngine::Alarm alarm);
+    void interlockFinished(bool confirmed, qint64 reaction_us, int attempts);
 
 private:
     void sendError(QSerialPort::SerialPortError error, const QString &error_message) override;
     void serialConnSendMessage() override;
-    bool verifyChecksum(const QString &data, const QString &checksum);
+    bool processReply(bool checksum_ok, int return_data);
+    void updateSnapshot(int command, int value);
+    void updateCache(int command, int value);
+    void returnCachedData(int command, int reply_command, const ReplyCallback &callback);
+    bool isCacheFresh(int command) const;
+    void evaluateAlarms(int command, int value);
+    void sendInterlockFrame();
+    void sendInterlockReadback();
+    void interlockTimeout();
+    void finishInterlock(bool confirmed);
+
+    Snapshot pending_snapshot;
+    QHash<int, CachedValue> state_cache;
+    int cache_max_age_ms = 0; // off, a button press always reads the controller
+    AlarmEngine alarm_engine;
+
+    WheelTimer interlock_timer;
+    bool interlock_active = false;
+    bool interlock_requested = false; // raised by an alarm while its reply is still being handled
+    qint64 interlock_trigger_ns = 0;
+    bool interlock_verify = false;  // a preempted reply may still come in, read the power status back
+    bool interlock_reading = false; // the GETPOWERSTATUS readback is on the wire
+    int interlock_attempts = 0;
+    int interlock_max_attempts = 5;
+    int interlock_timeout_ms = 100;
+    qint64 last_interlock_reaction_us = -1;
 
 private slots:
     void serialConnReceiveMessage() override;
     void sendMessage() override;
 };
 
+Q_DECLARE_METATYPE(OvenComm::Snapshot)
+
 #endif // OVENCOMM_H
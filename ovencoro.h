@@ -0,0 +1,139 @@
+#ifndef OVENCORO_H
+#define OVENCORO_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include "ovencomm.h"
+
+// Awaitable wrappers over OvenComm so a multi-step procedure reads top to bottom:
+//
+//   OvenCoro::Task soak(OvenComm *oven) {
+//       OvenCoro::AsyncOven async(oven);
+//       co_await async.setTemp(150.0);
+//       while ((co_await async.getTemp()).value < 14900) {
+//           co_await OvenCoro::delay(oven, 1000);
+//       }
+//       co_await async.setPowerStatus(false);
+//   }
+//
+// Everything resumes from the Qt event loop, never from inside the link, so any number
+// of sequences can run side by side on one thread without blocking it.
+namespace OvenCoro {
+
+// Fire and forget, runs until its first co_await when called and frees itself when done.
+// A sequence whose oven is deleted while it waits is never resumed.
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Resumes h on context's thread once control is back in the event loop
+inline void resumeLater(QObject *context, std::coroutine_handle<> h) {
+    QMetaObject::invokeMethod(context, [h]() { h.resume(); }, Qt::QueuedConnection);
+}
+
+// co_await yields the SerialComm::Reply of one request, ok is false on any failure
+class ReplyAwaiter {
+public:
+    typedef std::function<void(const SerialComm::ReplyCallback&)> Issue;
+
+    ReplyAwaiter(OvenComm *oven, Issue issue) : oven(oven), issue(std::move(issue)) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        QPointer<OvenComm> guard(oven);
+        issue([this, h, guard](const SerialComm::Reply &r) {
+            reply = r;
+            if (guard) {
+                resumeLater(guard, h);
+            }
+        });
+    }
+    SerialComm::Reply await_resume() const noexcept { return reply; }
+
+private:
+    OvenComm *oven;
+    Issue issue;
+    SerialComm::Reply reply;
+};
+
+// co_await delay(oven, ms) pauses the sequence without blocking the thread
+class DelayAwaiter {
+public:
+    DelayAwaiter(QObject *context, int ms) : context(context), ms(ms) {}
+
+    bool await_ready() const noexcept { return ms <= 0; }
+    void await_suspend(std::coroutine_handle<> h) {
+        QTimer::singleShot(ms, context, [h]() { h.resume(); });
+    }
+    void await_resume() const noexcept {}
+
+private:
+    QObject *context;
+    int ms;
+};
+
+inline DelayAwaiter delay(QObject *context, int ms) {
+    return DelayAwaiter(context, ms);
+}
+
+// Same calls as OvenComm, each returning an awaitable instead of going through returnData
+class AsyncOven {
+public:
+    explicit AsyncOven(OvenComm *oven) : oven(oven) {}
+
+    OvenComm *device() const { return oven; }
+
+    ReplyAwaiter setTemp(double temp, int priority = SerialComm::SET) {
+        OvenComm *o = oven;
+        return ReplyAwaiter(o, [o, temp, priority](const SerialComm::ReplyCallback &cb) {
+            o->setTemp(temp, priority, cb);
+        });
+    }
+    ReplyAwaiter getTemp(int priority = SerialComm::INTERACTIVE) {
+        return read(&OvenComm::getTemp, priority);
+    }
+    ReplyAwaiter getSetTemp(int priority = SerialComm::INTERACTIVE) {
+        return read(&OvenComm::getSetTemp, priority);
+    }
+    ReplyAwaiter getOutput(int priority = SerialComm::INTERACTIVE) {
+        return read(&OvenComm::getOutput, priority);
+    }
+    ReplyAwaiter getSensorStatus(int priority = SerialComm::INTERACTIVE) {
+        return read(&OvenComm::getSensorStatus, priority);
+    }
+    ReplyAwaiter setPowerStatus(bool on) {
+        OvenComm *o = oven;
+        return ReplyAwaiter(o, [o, on](const SerialComm::ReplyCallback &cb) {
+            o->setPowerStatus(on, cb);
+        });
+    }
+    ReplyAwaiter getPowerStatus(int priority = SerialComm::INTERACTIVE) {
+        return read(&OvenComm::getPowerStatus, priority);
+    }
+
+private:
+    typedef void (OvenComm::*ReadCall)(int, const SerialComm::ReplyCallback&);
+
+    ReplyAwaiter read(ReadCall call, int priority) {
+        OvenComm *o = oven;
+        return ReplyAwaiter(o, [o, call, priority](const SerialComm::ReplyCallback &cb) {
+            (o->*call)(priority, cb);
+        });
+    }
+
+    OvenComm *oven;
+};
+
+}
+
+#endif // OVENCORO_H
@@ -0,0 +1,175 @@
+#include "ovengateway.h"
+#include <QPointer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <memory>
+
+OvenGateway::OvenGateway(QObject *parent) : QObject(parent) {
+    connect(&server, &QTcpServer::newConnection, this, &OvenGateway::newConnection);
+}
+
+void OvenGateway::addOven(quint8 oven_id, OvenComm *oven) {
+    ovens.insert(oven_id, oven);
+}
+
+void OvenGateway::removeOven(quint8 oven_id) {
+    ovens.remove(oven_id);
+}
+
+bool OvenGateway::listen(const QHostAddress &address, quint16 port) {
+    return server.listen(address, port);
+}
+
+void OvenGateway::close() {
+    server.close();
+    for (QTcpSocket *socket : client_buffers.keys()) {
+        socket->abort();
+    }
+}
+
+bool OvenGateway::isListening() const {
+    return server.isListening();
+}
+
+quint16 OvenGateway::serverPort() const {
+    return server.serverPort();
+}
+
+QString OvenGateway::errorString() const {
+    return server.errorString();
+}
+
+int OvenGateway::clientCount() const {
+    return client_buffers.size();
+}
+
+void OvenGateway::setRequestDeadline(int deadline_ms) {
+    request_deadline_ms = qMax(1, deadline_ms);
+}
+
+//Private
+void OvenGateway::newConnection() {
+    while (QTcpSocket *socket = server.nextPendingConnection()) {
+        // replies are a dozen bytes, Nagle would hold each one for the previous ack
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        const QString peer = QString("%1:%2").arg(socket->peerAddress().toString()).arg(socket->peerPort());
+        client_buffers.insert(socket, QByteArray());
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { readClient(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket, peer]() {
+            // requests still queued answer into a QPointer that is null by then
+            client_buffers.remove(socket);
+            socket->deleteLater();
+            emit clientDisconnected(peer);
+        });
+        emit clientConnected(peer);
+    }
+}
+
+void OvenGateway::readClient(QTcpSocket *socket) {
+    QByteArray &buffer = client_buffers[socket];
+    buffer += socket->readAll();
+
+    // a request may complete synchronously (cached value, full queue), take them all out first
+    QList<QByteArray> frames;
+    QList<quint32> tags;
+    QList<quint8> oven_ids, priorities;
+    int offset = 0;
+    quint32 tag;
+    quint8 oven_id, priority;
+    QByteArray frame;
+    while (GatewayProtocol::decodeRequest(buffer, offset, tag, oven_id, priority, frame)) {
+        tags.append(tag);
+        oven_ids.append(oven_id);
+        priorities.append(priority);
+        frames.append(frame);
+    }
+    buffer.remove(0, offset);
+
+    for (int i=0; i<frames.length(); i++) {
+        handleRequest(socket, tags[i], oven_ids[i], priorities[i], frames[i]);
+    }
+}
+
+void OvenGateway::handleRequest(QTcpSocket *socket, quint32 tag, quint8 oven_id, quint8 priority,
+                                const QByteArray &frame) {
+    QPointer<QTcpSocket> client(socket);
+    // answered once, by the oven or by the deadline, whichever comes first
+    std::shared_ptr<bool> answered = std::make_shared<bool>(false);
+    auto respond = [client, tag, answered](quint8 status, const QByteArray &reply_frame) {
+        if (*answered) {
+            return;
+        }
+        *answered = true;
+        if (client && client->state() == QAbstractSocket::ConnectedState) {
+            client->write(GatewayProtocol::encodeResponse(tag, status, reply_frame));
+            client->flush();
+        }
+    };
+
+    OvenComm *oven = ovens.value(oven_id);
+    if (!oven || !oven->isOpen()) {
+        respond(QSerialPort::NotOpenError, QByteArray());
+        return;
+    }
+
+    // the frame as written by OvenComm::serialConnSendMessage
+    int command = 0;
+    int value = 0;
+    const int result = OvenCodec::decodeRequest(frame.constData(), frame.length(), command, value);
+    if (result == OvenCodec::BAD_CHECKSUM) {
+        respond(QSerialPort::ParityError, QByteArray());
+        return;
+    } else if (result != OvenCodec::VALID) {
+        respond(QSerialPort::UnsupportedOperationError, QByteArray());
+        return;
+    }
+
+    // the answer is rebuilt from the decoded value, so cached replies look like real ones
+    SerialComm::ReplyCallback callback = [respond](const SerialComm::Reply &reply) {
+        if (!reply.ok) {
+            respond(reply.error != QSerialPort::NoError ? reply.error : QSerialPort::UnknownError, QByteArray());
+            return;
+        }
+        char reply_frame[OvenCodec::reply_size];
+        const int length = OvenCodec::encodeReply(reply.value, reply_frame);
+        respond(QSerialPort::NoError, QByteArray(reply_frame, length));
+    };
+
+    // SAFETY stays reserved for this host's own interlock, power off is still sent as SAFETY by setPowerStatus
+    const int queue_priority = qBound((int)SerialComm::SET, (int)priority, (int)SerialComm::POLLING);
+    switch (command) {
+        case OvenComm::SETTEMP:
+            oven->setTemp((double)value / OvenCodec::scale(OvenComm::SETTEMP), queue_priority, callback);
+            break;
+        case OvenComm::GETTEMP:
+            oven->getTemp(queue_priority, callback);
+            break;
+        case OvenComm::GETSETTEMP:
+            oven->getSetTemp(queue_priority, callback);
+            break;
+        case OvenComm::GETOUTPUT:
+            oven->getOutput(queue_priority, callback);
+            break;
+        case OvenComm::GETSENSORSTATUS:
+            oven->getSensorStatus(queue_priority, callback);
+            break;
+        case OvenComm::SETPOWERSTATUS:
+            oven->setPowerStatus(value != 0, callback);
+            break;
+        case OvenComm::GETPOWERSTATUS:
+            oven->getPowerStatus(queue_priority, callback);
+            break;
+        default:
+            respond(QSerialPort::UnsupportedOperationError, QByteArray());
+            return;
+    }
+    // the client already paced this request, do not add a send_message_timer period on top
+    oven->sendPending();
+
+    if (!*answered) {
+        QTimer::singleShot(request_deadline_ms, this, [respond]() {
+            respond(QSerialPort::TimeoutError, QByteArray());
+        });
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef OVENGATEWAY_H
+#define OVENGATEWAY_H
+
+#include <QObject>
+#include <QHash>
+#include <QHostAddress>
+#include <QTcpServer>
+#include "ovencomm.h"
+#include "gatewayprotocol.h"
+
+// Shares the ovens of this process with other hosts over TCP, see gatewayprotocol.h.
+// Every request goes through the same OvenComm entry points as a local caller, so
+// remote clients are scheduled, cached and interlocked together with everything else
+// on the link. Requests are handled as they arrive, a client can pipeline as many as
+// the oven's queue limits take and replies go out in the order the oven answers.
+// A request the oven has not answered within the deadline is answered with
+// TimeoutError, a reply that comes later is dropped.
+//
+// A client is a SerialComm opened on a port named tcp://host:port/oven.
+class OvenGateway : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OvenGateway(QObject *parent = nullptr);
+
+    void addOven(quint8 oven_id, OvenComm *oven);
+    void removeOven(quint8 oven_id);
+
+    // localhost unless told otherwise, the protocol has no authentication
+    bool listen(const QHostAddress &address = QHostAddress::LocalHost,
+                quint16 port = GatewayProtocol::default_port);
+    void close();
+    bool isListening() const;
+    quint16 serverPort() const;
+    QString errorString() const;
+    int clientCount() const;
+    void setRequestDeadline(int deadline_ms); // the client's timeout must be longer
+
+signals:
+    void clientConnected(QString peer);
+    void clientDisconnected(QString peer);
+
+private:
+    void newConnection();
+    void readClient(QTcpSocket *socket);
+    void handleRequest(QTcpSocket *socket, quint32 tag, quint8 oven_id, quint8 priority,
+                       const QByteArray &frame);
+
+    QTcpServer server;
+    QHash<quint8, OvenComm*> ovens;
+    QHash<QTcpSocket*, QByteArray> client_buffers;
+    int request_deadline_ms = GatewayProtocol::request_deadline_ms;
+};
+
+#endif // OVENGATEWAY_H
@@ -0,0 +1,142 @@
+#include "ovenprofile.h"
+#include <QSettings>
+
+bool OvenProfile::hasPortIdentity() const {
+    return !serial_number.isEmpty() || (vendor_id != 0 && product_id != 0);
+}
+
+QString OvenProfile::resolvePort(const QList<QSerialPortInfo> &ports) const {
+    if (!serial_number.isEmpty()) {
+        for (const QSerialPortInfo &info : ports) {
+            if (info.serialNumber() == serial_number) {
+                return info.portName();
+            }
+        }
+        return QString();
+    }
+
+    if (vendor_id != 0 && product_id != 0) {
+        // several identical adapters can only be told apart by name, prefer the one last
+        // used, otherwise the first one found
+        QString match;
+        for (const QSerialPortInfo &info : ports) {
+            if (info.vendorIdentifier() == vendor_id && info.productIdentifier() == product_id) {
+                if (info.portName() == settings.name) {
+                    return info.portName();
+                }
+                if (match.isEmpty()) {
+                    match = info.portName();
+                }
+            }
+        }
+        return match;
+    }
+
+    return settings.name;
+}
+
+OvenProfile OvenProfile::fromSettings(quint16 oven_id, const SettingsDialog::Settings &settings,
+                                      const QList<QSerialPortInfo> &ports) {
+    OvenProfile profile;
+    profile.oven_id = oven_id;
+    profile.settings = settings;
+    for (const QSerialPortInfo &info : ports) {
+        if (info.portName() == settings.name) {
+            profile.serial_number = info.serialNumber();
+            profile.vendor_id = info.vendorIdentifier();
+            profile.product_id = info.productIdentifier();
+            break;
+        }
+    }
+    return profile;
+}
+
+QList<OvenProfile> OvenProfile::load() {
+    QList<OvenProfile> profiles;
+    QSettings store;
+    const int count = store.beginReadArray("ovens");
+    for (int i=0; i<count; i++) {
+        store.setArrayIndex(i);
+        OvenProfile profile;
+        profile.oven_id = store.value("ovenId").toUInt();
+        profile.serial_number = store.value("serialNumber").toString();
+        profile.vendor_id = store.value("vendorId").toUInt();
+        profile.product_id = store.value("productId").toUInt();
+
+        SettingsDialog::Settings &settings = profile.settings;
+        settings.name = store.value("portName").toString();
+        settings.baudRate = store.value("baudRate", QSerialPort::Baud9600).toInt();
+        settings.stringBaudRate = QString::number(settings.baudRate);
+        settings.dataBits = static_cast<QSerialPort::DataBits>(store.value("dataBits", QSerialPort::Data8).toInt());
+        settings.stringDataBits = QString::number(settings.dataBits);
+        settings.parity = static_cast<QSerialPort::Parity>(store.value("parity", QSerialPort::NoParity).toInt());
+        settings.stringParity = store.value("stringParity").toString();
+        settings.stopBits = static_cast<QSerialPort::StopBits>(store.value("stopBits", QSerialPort::OneStop).toInt());
+        settings.stringStopBits = store.value("stringStopBits").toString();
+        settings.flowControl = static_cast<QSerialPort::FlowControl>(store.value("flowControl", QSerialPort::NoFlowControl).toInt());
+        settings.stringFlowControl = store.value("stringFlowControl").toString();
+        settings.localEchoEnabled = store.value("localEcho", false).toBool();
+        settings.lowLatency = store.value("lowLatency", false).toBool();
+        settings.autoConnect = store.value("autoConnect", true).toBool();
+
+        profile.poll_enabled = store.value("pollEnabled", false).toBool();
+        profile.poll_min_ms = store.value("pollMinMs", 250).toInt();
+        profile.poll_max_ms = store.value("pollMaxMs", 5000).toInt();
+        profiles.append(profile);
+    }
+    store.endArray();
+    return profiles;
+}
+
+void OvenProfile::save(const QList<OvenProfile> &profiles) {
+    QSettings store;
+    store.remove("ovens");
+    store.beginWriteArray("ovens", profiles.size());
+    for (int i=0; i<profiles.size(); i++) {
+        const OvenProfile &profile = profiles[i];
+        const SettingsDialog::Settings &settings = profile.settings;
+        store.setArrayIndex(i);
+        store.setValue("ovenId", profile.oven_id);
+        store.setValue("serialNumber", profile.serial_number);
+        store.setValue("vendorId", profile.vendor_id);
+        store.setValue("productId", profile.product_id);
+
+        store.setValue("portName", settings.name);
+        store.setValue("baudRate", settings.baudRate);
+        store.setValue("dataBits", settings.dataBits);
+        store.setValue("parity", settings.parity);
+        store.setValue("stringParity", settings.stringParity);
+        store.setValue("stopBits", settings.stopBits);
+        store.setValue("stringStopBits", settings.stringStopBits);
+        store.setValue("flowControl", settings.flowControl);
+        store.setValue("stringFlowControl", settings.stringFlowControl);
+        store.setValue("localEcho", settings.localEchoEnabled);
+        store.setValue("lowLatency", settings.lowLatency);
+        store.setValue("autoConnect", settings.autoConnect);
+
+        store.setValue("pollEnabled", profile.poll_enabled);
+        store.setValue("pollMinMs", profile.poll_min_ms);
+        store.setValue("pollMaxMs", profile.poll_max_ms);
+    }
+    store.endArray();
+}
+
+void OvenProfile::store(const OvenProfile &profile) {
+    QList<OvenProfile> profiles = load();
+    bool replaced = false;
+    for (OvenProfile &existing : profiles) {
+        if (existing.oven_id == profile.oven_id) {
+            // the polling plan is only edited in the settings file, keep it
+            OvenProfile updated = profile;
+            updated.poll_enabled = existing.poll_enabled;
+            updated.poll_min_ms = existing.poll_min_ms;
+            updated.poll_max_ms = existing.poll_max_ms;
+            existing = updated;
+            replaced = true;
+        }
+    }
+    if (!replaced) {
+        profiles.append(profile);
+    }
+    save(profiles);
+}
@@ -0,0 +1,37 @@
+#ifndef OVENPROFILE_H
+#define OVENPROFILE_H
+
+#include <QList>
+#include <QSerialPortInfo>
+#include <QString>
+#include "settingsdialog.h"
+
+// Everything needed to bring one oven back after a restart, kept in QSettings under
+// "ovens". The port is found again by serial number, then VID/PID, then by name,
+// so a USB adapter that comes back as a different ttyUSB still matches.
+struct OvenProfile
+{
+    quint16 oven_id = 0;
+    QString serial_number;
+    quint16 vendor_id = 0;
+    quint16 product_id = 0;
+    SettingsDialog::Settings settings; // settings.name is the last port it was seen on
+
+    // polling plan, see AdaptivePoller
+    bool poll_enabled = false;
+    int poll_min_ms = 250;
+    int poll_max_ms = 5000;
+
+    bool hasPortIdentity() const;
+    QString resolvePort(const QList<QSerialPortInfo> &ports) const;
+
+    // identity taken from the enumerated port the settings point at
+    static OvenProfile fromSettings(quint16 oven_id, const SettingsDialog::Settings &settings,
+                                    const QList<QSerialPortInfo> &ports);
+
+    static QList<OvenProfile> load();
+    static void save(const QList<OvenProfile> &profiles);
+    static void store(const OvenProfile &profile); // replaces the profile with the same oven_id
+};
+
+#endif // OVENPROFILE_H
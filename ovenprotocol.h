@@ -0,0 +1,43 @@
+#ifndef OVENPROTOCOL_H
+#define OVENPROTOCOL_H
+
+#include "protocoltraits.h"
+
+// Oven controller framing: *CCDDDDss\r answered by *DDDDss^, ss being the low byte
+// of the sum of the command and data characters. Cards on a shared RS-485 bus take
+// *AACCDDDDss\r and answer *AADDDDss^, AA being their hex address, see OvenBus.
+struct OvenProtocol {
+    enum commands { NONE=0, GETTEMP=1, GETOUTPUT=3, GETSENSORSTATUS=4, GETSETTEMP=30,
+                    GETPOWERSTATUS=35, SETTEMP=60, SETPOWERSTATUS=65 };
+
+    static constexpr char request_start = '*';
+    static constexpr char request_end = '\r';
+    static constexpr char reply_start = '*';
+    static constexpr char reply_end = '^';
+    static constexpr int command_digits = 2;
+    static constexpr int data_digits = 4;
+    static constexpr int checksum_digits = 2;
+    static constexpr int address_digits = 2;
+
+    static constexpr quint32 checksum(const char *data, int length) {
+        quint32 sum = 0;
+        for (int i=0; i<length; i++) {
+            sum += (quint8)data[i];
+        }
+        return sum & 0xff;
+    }
+
+    static constexpr ProtocolCommand command_table[] = {
+        { GETTEMP, "temp", 100.0, GETTEMP },
+        { GETSETTEMP, "set_temp", 100.0, GETSETTEMP },
+        { SETTEMP, "set_temp", 100.0, GETSETTEMP },
+        { GETOUTPUT, "output", 28800.0, GETOUTPUT },
+        { GETSENSORSTATUS, "sensor_status", 1.0, GETSENSORSTATUS },
+        { GETPOWERSTATUS, "power_status", 1.0, GETPOWERSTATUS },
+        { SETPOWERSTATUS, "power_status", 1.0, GETPOWERSTATUS },
+    };
+};
+
+typedef FrameCodec<OvenProtocol> OvenCodec;
+
+#endif // OVENPROTOCOL_H
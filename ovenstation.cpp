@@ -0,0 +1,322 @@
+#include "ovenstation.h"
+#include "adaptivepoller.h"
+#include "ovenbus.h"
+#include "ovengateway.h"
+#include "portenumerator.h"
+#include "profileengine.h"
+#include "telemetryrecorder.h"
+#include "telemetryserver.h"
+#include <QFileInfo>
+#include <memory>
+
+OvenStation::OvenStation(QObject *parent) : QObject(parent) {
+    connect(PortEnumerator::instance(), &PortEnumerator::portsChanged, this, &OvenStation::portsChanged);
+    connect(&checkpoint_timer, &QTimer::timeout, this, &OvenStation::writeCheckpoint);
+}
+
+OvenStation::~OvenStation() {
+    if (!checkpoint_file.isEmpty()) {
+        writeCheckpoint();
+    }
+}
+
+void OvenStation::addOven(const OvenProfile &profile, OvenComm *oven) {
+    Station station;
+    station.profile = profile;
+    if (!oven) {
+        // nobody presses buttons on these, their readers are pollers and remote clients
+        oven = new OvenComm(this);
+        oven->setCacheMaxAge(5000);
+    }
+    station.oven = oven;
+    if (profile.poll_enabled) {
+        station.poller = new AdaptivePoller(station.oven, this);
+        station.poller->setIntervalRange(profile.poll_min_ms, profile.poll_max_ms);
+    }
+    station.profile_engine = new ProfileEngine(station.oven, this);
+
+    const quint16 oven_id = profile.oven_id;
+    OvenComm *comm = station.oven;
+    connect(comm, &OvenComm::errorSignal, this,
+            [this, oven_id, comm](QSerialPort::SerialPortError error, QString, int) {
+        // adapter gone, it is picked up again by portsChanged once it is back
+        if (error == QSerialPort::ResourceError && comm->isOpen()) {
+            comm->closeSerialPort();
+            emit ovenDisconnected(oven_id);
+        }
+    });
+    stations.append(station);
+    if (oven_gateway && oven_id <= 255) {
+        oven_gateway->addOven(oven_id, station.oven);
+    }
+    if (telemetry_server) {
+        telemetry_server->addOven(oven_id, station.oven);
+    }
+}
+
+void OvenStation::updateProfile(const OvenProfile &profile) {
+    for (Station &station : stations) {
+        if (station.profile.oven_id == profile.oven_id) {
+            OvenProfile updated = profile;
+            updated.poll_enabled = station.profile.poll_enabled;
+            updated.poll_min_ms = station.profile.poll_min_ms;
+            updated.poll_max_ms = station.profile.poll_max_ms;
+            station.profile = updated;
+        }
+    }
+}
+
+void OvenStation::loadProfiles(OvenComm *interactive_oven) {
+    for (const OvenProfile &profile : OvenProfile::load()) {
+        addOven(profile, profile.oven_id == 0 ? interactive_oven : nullptr);
+    }
+}
+
+void OvenStation::connectAll() {
+    // each open is a handful of syscalls, all ovens are up within the same event loop pass
+    for (Station &station : stations) {
+        tryConnect(station);
+    }
+}
+
+void OvenStation::setAutoConnect(quint16 oven_id, bool enabled) {
+    for (Station &station : stations) {
+        if (station.profile.oven_id == oven_id) {
+            station.profile.settings.autoConnect = enabled;
+        }
+    }
+}
+
+OvenComm *OvenStation::oven(quint16 oven_id) const {
+    for (const Station &station : stations) {
+        if (station.profile.oven_id == oven_id) {
+            return station.oven;
+        }
+    }
+    return nullptr;
+}
+
+ProfileEngine *OvenStation::profileEngine(quint16 oven_id) const {
+    for (const Station &station : stations) {
+        if (station.profile.oven_id == oven_id) {
+            return station.profile_engine;
+        }
+    }
+    return nullptr;
+}
+
+void OvenStation::setRecorder(quint16 oven_id, TelemetryRecorder *recorder) {
+    for (Station &station : stations) {
+        if (station.profile.oven_id == oven_id) {
+            station.recorder = recorder;
+        }
+    }
+}
+
+void OvenStation::enableCheckpoints(const QString &file_name, int interval_ms) {
+    checkpoint_file = file_name;
+
+    QList<StationCheckpoint::OvenState> states;
+    qint64 saved_ms = 0;
+    if (StationCheckpoint::load(checkpoint_file, states, saved_ms)) {
+        for (const StationCheckpoint::OvenState &state : states) {
+            restored.insert(state.oven_id, state);
+        }
+    }
+
+    checkpoint_timer.start(interval_ms);
+}
+
+bool OvenStation::writeCheckpoint() {
+    QList<StationCheckpoint::OvenState> states;
+    for (const Station &station : stations) {
+        states.append(checkpointState(station));
+    }
+    return StationCheckpoint::save(checkpoint_file, states);
+}
+
+StationCheckpoint::OvenState OvenStation::checkpointState(const Station &station) const {
+    // an oven that has not come back yet keeps what the previous run knew
+    StationCheckpoint::OvenState state = restored.value(station.profile.oven_id);
+    state.oven_id = station.profile.oven_id;
+
+    const OvenComm::CachedValue set_temp = station.oven->cachedValue(OvenComm::GETSETTEMP);
+    if (set_temp.valid) {
+        state.set_temp_valid = true;
+        state.set_temp = set_temp.value;
+    }
+    const OvenComm::CachedValue power = station.oven->cachedValue(OvenComm::GETPOWERSTATUS);
+    if (power.valid) {
+        state.power_valid = true;
+        state.power_on = power.value;
+    }
+    if (station.poller && station.poller->isRunning()) {
+        state.poll_interval_ms = station.poller->interval();
+    }
+    if (station.profile_engine->isRunning()) {
+        state.profile = station.profile_engine->points();
+        state.profile_running = true;
+        state.profile_elapsed_ms = station.profile_engine->elapsed();
+    } else if (!restored.contains(station.profile.oven_id)) {
+        state.profile.clear();
+        state.profile_running = false;
+        state.profile_elapsed_ms = 0;
+    }
+    if (station.recorder && station.recorder->isRecording()) {
+        state.log_file = station.recorder->fileName();
+        state.log_offset = station.recorder->archiveOffset();
+    } else if (!restored.contains(station.profile.oven_id)) {
+        state.log_file.clear();
+        state.log_offset = 0;
+    }
+    return state;
+}
+
+void OvenStation::reconcile(Station &station) {
+    const quint16 oven_id = station.profile.oven_id;
+    if (!restored.contains(oven_id)) {
+        return;
+    }
+    const StationCheckpoint::OvenState state = restored.take(oven_id);
+    OvenComm *comm = station.oven;
+    ProfileEngine *engine = station.profile_engine;
+
+    // an archive shorter than what was on disk at the checkpoint is not the same file any more
+    if (station.recorder && !station.recorder->isRecording() && !state.log_file.isEmpty()
+            && QFileInfo(state.log_file).size() >= state.log_offset) {
+        station.recorder->resume(state.log_file);
+    }
+
+    // two reads, both land in the OvenComm cache so nothing already in effect is written again
+    std::shared_ptr<bool> power_matches = std::make_shared<bool>(true);
+    comm->getPowerStatus(SerialComm::INTERACTIVE, [state, power_matches](const SerialComm::Reply &reply) {
+        if (reply.ok && state.power_valid) {
+            *power_matches = (bool)reply.value == state.power_on;
+        }
+    });
+    comm->getSetTemp(SerialComm::INTERACTIVE,
+                     [this, oven_id, state, comm, engine, power_matches](const SerialComm::Reply &reply) {
+        bool resent = false;
+        if (state.profile_running && !state.profile.isEmpty()) {
+            // its first tick compares against the setpoint just read
+            engine->setProfile(state.profile);
+            engine->start(state.profile_elapsed_ms, reply.ok ? reply.value : INT_MIN);
+        } else if (reply.ok && state.set_temp_valid && reply.value != state.set_temp) {
+            comm->setTemp(state.set_temp / 100.0);
+            resent = true;
+        }
+        emit ovenReconciled(oven_id, resent, *power_matches);
+    });
+}
+
+bool OvenStation::startGateway(quint16 port, const QHostAddress &address) {
+    if (!oven_gateway) {
+        oven_gateway = new OvenGateway(this);
+        for (const Station &station : stations) {
+            if (station.profile.oven_id <= 255) {
+                oven_gateway->addOven(station.profile.oven_id, station.oven);
+            }
+        }
+    }
+    return oven_gateway->isListening() || oven_gateway->listen(address, port);
+}
+
+OvenGateway *OvenStation::gateway() const {
+    return oven_gateway;
+}
+
+bool OvenStation::startTelemetryServer(quint16 port, const QHostAddress &address) {
+    if (!telemetry_server) {
+        telemetry_server = new TelemetryServer(this);
+        for (const Station &station : stations) {
+            telemetry_server->addOven(station.profile.oven_id, station.oven);
+        }
+    }
+    return telemetry_server->isListening() || telemetry_server->listen(address, port);
+}
+
+TelemetryServer *OvenStation::telemetryServer() const {
+    return telemetry_server;
+}
+
+QList<quint16> OvenStation::ovenIds() const {
+    QList<quint16> ids;
+    for (const Station &station : stations) {
+        ids.append(station.profile.oven_id);
+    }
+    return ids;
+}
+
+bool OvenStation::tryConnect(Station &station) {
+    if (!station.profile.settings.autoConnect || station.oven->isOpen()) {
+        return false;
+    }
+
+    // identity needs the enumerated port list, a plain name does not wait for it
+    QString port_name;
+    if (station.profile.hasPortIdentity()) {
+        if (!PortEnumerator::instance()->isReady()) {
+            return false;
+        }
+        port_name = station.profile.resolvePort(PortEnumerator::instance()->ports());
+    } else {
+        port_name = station.profile.settings.name;
+    }
+    if (port_name.isEmpty()) {
+        return false;
+    }
+    // a card on a shared bus is present when its adapter is
+    QString adapter_name = port_name;
+    quint8 bus_address = 0;
+    const bool on_bus = SerialBus::parseBusName(port_name, adapter_name, bus_address);
+
+    // once the list is known, do not keep failing opens on a port that is not there
+    if (PortEnumerator::instance()->isReady() && !SerialComm::isGatewayName(port_name)) {
+        bool present = false;
+        for (const QSerialPortInfo &info : PortEnumerator::instance()->ports()) {
+            present = present || info.portName() == adapter_name || info.systemLocation() == adapter_name;
+        }
+        if (!present) {
+            return false;
+        }
+    }
+
+    SettingsDialog::Settings settings = station.profile.settings;
+    settings.name = port_name;
+    station.oven->updateSerialInfo(settings);
+    if (on_bus) {
+        SerialBus *&bus = buses[adapter_name];
+        if (!bus) {
+            bus = new OvenBus<>(this);
+        }
+        if (bus->link(bus_address) != station.oven) {
+            bus->addLink(bus_address, station.oven);
+        }
+        settings.name = adapter_name;
+        if (!bus->open(settings)) {
+            return false;
+        }
+    }
+    station.oven->openSerialPort();
+    if (!station.oven->isOpen()) {
+        return false;
+    }
+
+    station.oven->startSendMessageTimer();
+    if (station.poller) {
+        station.poller->start(restored.value(station.profile.oven_id).poll_interval_ms);
+    }
+    emit ovenConnected(station.profile.oven_id, port_name);
+    reconcile(station);
+    return true;
+}
+
+//Slots
+void OvenStation::portsChanged() {
+    for (Station &station : stations) {
+        if (station.poller && !station.oven->isOpen()) {
+            station.poller->stop();
+        }
+        tryConnect(station);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef OVENSTATION_H
+#define OVENSTATION_H
+
+#include <QObject>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QPointer>
+#include <QTimer>
+#include "ovencomm.h"
+#include "ovenprofile.h"
+#include "stationcheckpoint.h"
+
+class AdaptivePoller;
+class SerialBus;
+class OvenGateway;
+class TelemetryServer;
+class ProfileEngine;
+class TelemetryRecorder;
+
+// Brings up every saved oven at startup without operator input. Profiles without a
+// port identity connect straight away by name, the others as soon as background
+// enumeration has found their adapter. Ovens that fail or are unplugged are tried
+// again whenever the port list changes.
+//
+// With checkpoints enabled the last confirmed setpoint and power status, poll rate,
+// profile progress and archive position of every oven are saved periodically. After
+// a restart each oven is reconciled with two reads as it connects: a setpoint the
+// controller still holds is not sent again, a profile resumes where it stopped and
+// recording continues in the same archive. A power state that differs is only
+// reported, the station never turns an oven on by itself.
+//
+// Ovens whose port is named rs485://port/address share one OvenBus per port, opened
+// with the line settings of the first of them to connect.
+class OvenStation : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OvenStation(QObject *parent = nullptr);
+    ~OvenStation(); // writes a last checkpoint, delete it before the ovens and recorders
+
+    // oven is used as is when given, e.g. the one MainWindow drives, otherwise one is created
+    void addOven(const OvenProfile &profile, OvenComm *oven = nullptr);
+    void updateProfile(const OvenProfile &profile); // line settings and identity, takes effect on the next connect
+    void loadProfiles(OvenComm *interactive_oven); // oven_id 0 goes to interactive_oven
+    void connectAll();
+    void setAutoConnect(quint16 oven_id, bool enabled); // this session only, e.g. after a manual disconnect
+
+    OvenComm *oven(quint16 oven_id) const;
+    ProfileEngine *profileEngine(quint16 oven_id) const;
+    QList<quint16> ovenIds() const;
+    void setRecorder(quint16 oven_id, TelemetryRecorder *recorder);
+
+    // restores from file_name now, call before connectAll()
+    void enableCheckpoints(const QString &file_name = StationCheckpoint::defaultFileName(),
+                           int interval_ms = 10000);
+    bool writeCheckpoint();
+
+    // shares every oven with id 0..255 over TCP under its oven_id, see OvenGateway
+    bool startGateway(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+    OvenGateway *gateway() const;
+    // live values of every oven for browser dashboards, see TelemetryServer; pass
+    // QHostAddress::Any explicitly to serve dashboards on other hosts
+    bool startTelemetryServer(quint16 port, const QHostAddress &address = QHostAddress::LocalHost);
+    TelemetryServer *telemetryServer() const;
+
+signals:
+    void ovenConnected(quint16 oven_id, QString port_name);
+    void ovenDisconnected(quint16 oven_id);
+    void ovenReconciled(quint16 oven_id, bool setpoint_resent, bool power_matches);
+
+private:
+    struct Station {
+        OvenProfile profile;
+        OvenComm *oven = nullptr;
+        AdaptivePoller *poller = nullptr;
+        ProfileEngine *profile_engine = nullptr;
+        QPointer<TelemetryRecorder> recorder; // owned elsewhere, may go first
+    };
+
+    bool tryConnect(Station &station);
+    void reconcile(Station &station);
+    StationCheckpoint::OvenState checkpointState(const Station &station) const;
+
+    QList<Station> stations;
+    QString checkpoint_file;
+    QTimer checkpoint_timer;
+    QHash<quint16, StationCheckpoint::OvenState> restored; // not yet reconciled
+    QHash<QString, SerialBus*> buses; // by adapter port name
+    OvenGateway *oven_gateway = nullptr;
+    TelemetryServer *telemetry_server = nullptr;
+
+private slots:
+    void portsChanged();
+};
+
+#endif // OVENSTATION_H
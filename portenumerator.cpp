@@ -0,0 +1,146 @@
+#include "portenumerator.h"
+#include <QDebug>
+#include <QSocketNotifier>
+#include <QtConcurrent/QtConcurrentRun>
+
+#ifdef Q_OS_LINUX
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+PortEnumerator *PortEnumerator::instance() {
+    static PortEnumerator *enumerator = nullptr;
+    if (enumerator == nullptr) {
+        enumerator = new PortEnumerator();
+    }
+    return enumerator;
+}
+
+PortEnumerator::PortEnumerator(QObject *parent) : QObject(parent) {
+    connect(&watcher, &QFutureWatcher<QList<QSerialPortInfo>>::finished,
+            this, &PortEnumerator::enumerationFinished);
+    debounce_timer.setSingleShot(true);
+    debounce_timer.setInterval(200);
+    connect(&debounce_timer, &QTimer::timeout, this, &PortEnumerator::refresh);
+
+    // watch first, a port plugged in during the first enumeration is not missed
+    startHotplugWatch();
+    refresh();
+}
+
+PortEnumerator::~PortEnumerator() {
+#ifdef Q_OS_LINUX
+    if (uevent_fd != -1) {
+        close(uevent_fd);
+    }
+#endif
+}
+
+QList<QSerialPortInfo> PortEnumerator::ports() const {
+    return cached_ports;
+}
+
+bool PortEnumerator::isReady() const {
+    return ready;
+}
+
+void PortEnumerator::refresh() {
+    if (watcher.isRunning()) {
+        refresh_again = true;
+        return;
+    }
+    refresh_again = false;
+    watcher.setFuture(QtConcurrent::run(&QSerialPortInfo::availablePorts));
+}
+
+void PortEnumerator::startHotplugWatch() {
+#ifdef Q_OS_LINUX
+    uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (uevent_fd == -1) {
+        qDebug() << "uevent socket failed:" << strerror(errno);
+        return;
+    }
+
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1; // kernel uevents
+    if (bind(uevent_fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == -1) {
+        qDebug() << "uevent bind failed:" << strerror(errno);
+        close(uevent_fd);
+        uevent_fd = -1;
+        return;
+    }
+
+    uevent_notifier = new QSocketNotifier(uevent_fd, QSocketNotifier::Read, this);
+    connect(uevent_notifier, &QSocketNotifier::activated, this, &PortEnumerator::readUevents);
+#endif
+}
+
+void PortEnumerator::handleUevent(const char *message, int length) {
+    // "action@devpath\0KEY=value\0KEY=value\0..."
+    QByteArray action;
+    QByteArray subsystem;
+    QByteArray devname;
+    const char *end = message + length;
+    const char *field = message;
+    while (field < end) {
+        int field_length = qstrnlen(field, end - field);
+        QByteArray entry = QByteArray::fromRawData(field, field_length);
+        field += field_length + 1;
+        if (entry.startsWith("ACTION=")) {
+            action = entry.mid(7);
+        } else if (entry.startsWith("SUBSYSTEM=")) {
+            subsystem = entry.mid(10);
+        } else if (entry.startsWith("DEVNAME=")) {
+            devname = entry.mid(8);
+        }
+    }
+
+    if (subsystem != "tty" || devname.isEmpty()) {
+        return;
+    }
+
+    if (action == "remove") {
+        // an enumeration already running may still list it
+        if (watcher.isRunning()) {
+            refresh_again = true;
+        }
+        const QString name = QString::fromLocal8Bit(devname.mid(devname.lastIndexOf('/') + 1));
+        for (int i=0; i<cached_ports.length(); i++) {
+            if (cached_ports[i].portName() == name) {
+                cached_ports.removeAt(i);
+                emit portsChanged();
+                break;
+            }
+        }
+    } else if (action == "add") {
+        // descriptions come from udev, give it a moment to finish with the new node
+        debounce_timer.start();
+    }
+}
+
+//Slots
+void PortEnumerator::enumerationFinished() {
+    cached_ports = watcher.result();
+    ready = true;
+    emit portsChanged();
+
+    if (refresh_again) {
+        refresh();
+    }
+}
+
+void PortEnumerator::readUevents() {
+#ifdef Q_OS_LINUX
+    char buffer[8192];
+    ssize_t length;
+    while ((length = recv(uevent_fd, buffer, sizeof(buffer) - 1, 0)) > 0) {
+        buffer[length] = '\0';
+        handleUevent(buffer, length);
+    }
+#endif
+}
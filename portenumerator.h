@@ -0,0 +1,50 @@
+#ifndef PORTENUMERATOR_H
+#define PORTENUMERATOR_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QList>
+#include <QSerialPortInfo>
+#include <QTimer>
+
+class QSocketNotifier;
+
+// Keeps the list of serial ports off the startup path. availablePorts() runs on a
+// pool thread and the result is cached; on Linux a netlink uevent socket keeps the
+// cache current, removals are applied directly and additions re-enumerate once in
+// the background after a short debounce.
+class PortEnumerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    static PortEnumerator *instance(); // GUI thread only
+
+    QList<QSerialPortInfo> ports() const;
+    bool isReady() const; // false until the first enumeration finished
+    void refresh();
+
+signals:
+    void portsChanged();
+
+private:
+    explicit PortEnumerator(QObject *parent = nullptr);
+    ~PortEnumerator();
+
+    void startHotplugWatch();
+    void handleUevent(const char *message, int length);
+
+    QList<QSerialPortInfo> cached_ports;
+    bool ready = false;
+    bool refresh_again = false; // a change came in while enumerating
+    QFutureWatcher<QList<QSerialPortInfo>> watcher;
+    QTimer debounce_timer;
+    int uevent_fd = -1;
+    QSocketNotifier *uevent_notifier = nullptr;
+
+private slots:
+    void enumerationFinished();
+    void readUevents();
+};
+
+#endif // PORTENUMERATOR_H
@@ -0,0 +1,123 @@
+#include "profileengine.h"
+#include <QPointer>
+#include <QtMath>
+
+ProfileEngine::ProfileEngine(OvenComm *oven, QObject *parent) : QObject(parent), oven(oven) {
+    connect(&tick_timer, &QTimer::timeout, this, &ProfileEngine::tick);
+    tick_timer.setInterval(1000);
+}
+
+void ProfileEngine::setProfile(const QVector<Point> &points) {
+    profile = points;
+}
+
+QVector<ProfileEngine::Point> ProfileEngine::points() const {
+    return profile;
+}
+
+void ProfileEngine::clearProfile(double start_temp) {
+    profile.clear();
+    profile.append({0, start_temp});
+}
+
+void ProfileEngine::addRamp(double target_temp, qint64 duration_ms) {
+    if (profile.isEmpty()) {
+        // ramp from where the controller is, when that is known
+        const OvenComm::CachedValue current = oven->cachedValue(OvenComm::GETSETTEMP);
+        clearProfile(current.valid ? current.value / OvenCodec::scale(OvenComm::GETSETTEMP) : target_temp);
+    }
+    profile.append({profile.last().time_ms + duration_ms, target_temp});
+}
+
+void ProfileEngine::addSoak(qint64 duration_ms) {
+    if (!profile.isEmpty()) {
+        profile.append({profile.last().time_ms + duration_ms, profile.last().temp});
+    }
+}
+
+void ProfileEngine::start(qint64 from_ms, int in_effect) {
+    if (profile.isEmpty()) {
+        return;
+    }
+    start_offset_ms = from_ms;
+    last_sent = in_effect;
+    last_confirmed = in_effect;
+    run_timer.start();
+    tick_timer.start();
+    tick();
+}
+
+void ProfileEngine::stop() {
+    tick_timer.stop();
+    run_timer.invalidate();
+}
+
+bool ProfileEngine::isRunning() const {
+    return tick_timer.isActive();
+}
+
+qint64 ProfileEngine::elapsed() const {
+    if (!run_timer.isValid()) {
+        return start_offset_ms;
+    }
+    return start_offset_ms + run_timer.elapsed();
+}
+
+void ProfileEngine::setTickInterval(int interval_ms) {
+    tick_timer.setInterval(interval_ms);
+}
+
+double ProfileEngine::setpointAt(qint64 time_ms) const {
+    if (time_ms <= profile.first().time_ms) {
+        return profile.first().temp;
+    }
+
+    for (int i=1; i<profile.length(); i++) {
+        const Point &from = profile[i-1];
+        const Point &to = profile[i];
+        if (time_ms < to.time_ms) {
+            double fraction = (double)(time_ms - from.time_ms) / (double)(to.time_ms - from.time_ms);
+            return from.temp + (to.temp - from.temp) * fraction;
+        }
+    }
+    return profile.last().temp;
+}
+
+//Slots
+void ProfileEngine::tick() {
+    if (profile.isEmpty()) {
+        stop();
+        return;
+    }
+
+    qint64 now_ms = elapsed();
+    double setpoint = setpointAt(now_ms);
+
+    // only the value the controller actually sees matters, skip writes that would not change it
+    const double scale = OvenCodec::scale(OvenComm::SETTEMP);
+    int encoded = qRound(setpoint * scale);
+    if (encoded != last_sent && oven->isOpen()) {
+        // set first, a rejected write calls back before setTemp returns
+        last_sent = encoded;
+        QPointer<ProfileEngine> engine(this);
+        oven->setTemp(encoded / scale, OvenComm::SET, [engine, encoded](const SerialComm::Reply &reply) {
+            if (!engine || engine->last_sent != encoded) {
+                return; // a newer one went out
+            }
+            if (reply.ok || reply.error == QSerialPort::UnsupportedOperationError) {
+                // done, or out of range and refused for good, resending cannot help
+                engine->last_confirmed = encoded;
+            } else {
+                // write did not make it, send it again on the next tick
+                engine->last_sent = INT_MIN;
+            }
+        });
+        emit setpointChanged(encoded / scale);
+    }
+
+    // a write that fails on the last tick still gets its retry
+    if (now_ms >= profile.last().time_ms && last_confirmed == encoded) {
+        stop();
+        emit profileFinished();
+    }
+}
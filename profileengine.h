@@ -0,0 +1,58 @@
+#ifndef PROFILEENGINE_H
+#define PROFILEENGINE_H
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <climits>
+#include "ovencomm.h"
+
+// Runs a piecewise-linear setpoint schedule (ramp, soak, cool) against one oven.
+// A SETTEMP is only queued when the encoded value changes. The engine runs past the
+// end of the profile until the controller has confirmed the last setpoint.
+class ProfileEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Point {
+        qint64 time_ms; // from profile start
+        double temp;
+    };
+
+    explicit ProfileEngine(OvenComm *oven, QObject *parent = nullptr);
+
+    void setProfile(const QVector<Point> &points);
+    QVector<Point> points() const;
+    void clearProfile(double start_temp);
+    void addRamp(double target_temp, qint64 duration_ms); // on an empty profile, from the cached setpoint
+    void addSoak(qint64 duration_ms);
+
+    // in_effect is the encoded setpoint the controller already holds, not written again
+    void start(qint64 from_ms = 0, int in_effect = INT_MIN);
+    void stop();
+    bool isRunning() const;
+    qint64 elapsed() const;
+    void setTickInterval(int interval_ms);
+
+    double setpointAt(qint64 time_ms) const;
+
+signals:
+    void setpointChanged(double temp);
+    void profileFinished();
+
+private:
+    OvenComm *oven;
+    QVector<Point> profile;
+    QTimer tick_timer;
+    QElapsedTimer run_timer;
+    qint64 start_offset_ms = 0;
+    int last_sent = INT_MIN;
+    int last_confirmed = INT_MIN; // last_sent once the controller holds it
+
+private slots:
+    void tick();
+};
+
+#endif // PROFILEENGINE_H
@@ -0,0 +1,243 @@
+#ifndef PROTOCOLTRAITS_H
+#define PROTOCOLTRAITS_H
+
+#include <QtGlobal>
+
+// Controllers on the bench (ovens, chillers, humidity controllers) all speak the same
+// kind of ASCII protocol: a start byte, a decimal command, hex data, a hex checksum
+// and an end byte, answered by hex data, checksum and an end byte. A device type is
+// described by a traits struct and everything else is generated from it at compile
+// time by FrameCodec, see ovenprotocol.h for the oven:
+//
+//   struct ChillerProtocol {
+//       enum commands { NONE=0, GETTEMP=1, SETTEMP=40 };
+//       static constexpr char request_start = '*';
+//       static constexpr char request_end = '\r';
+//       static constexpr char reply_start = '*';
+//       static constexpr char reply_end = '^';
+//       static constexpr int command_digits = 2;  // decimal
+//       static constexpr int data_digits = 4;     // hex
+//       static constexpr int checksum_digits = 2; // hex
+//       static constexpr int address_digits = 2;  // hex, RS-485 multidrop only
+//       static constexpr quint32 checksum(const char *data, int length);
+//       static constexpr ProtocolCommand command_table[] = { ... };
+//   };
+//
+// DeviceComm<ChillerProtocol> is then a working link with the SerialComm scheduler.
+
+// One entry of a protocol's command table
+struct ProtocolCommand {
+    int command;
+    const char *name;  // for logs and JSON
+    double scale;      // wire value / scale = value in device units
+    int state;         // the read whose value this command sets or returns
+};
+
+template <typename Protocol>
+class FrameCodec
+{
+public:
+    enum results { INCOMPLETE=0, VALID=1, BAD_CHECKSUM=2, MALFORMED=3 };
+
+    static constexpr int request_size = 1 + Protocol::command_digits + Protocol::data_digits
+            + Protocol::checksum_digits + 1;
+    static constexpr int reply_size = 1 + Protocol::data_digits + Protocol::checksum_digits + 1;
+    // on a multidrop bus the address follows the start byte of both frames and is checksummed
+    static constexpr int addressed_request_size = request_size + Protocol::address_digits;
+    static constexpr int addressed_reply_size = reply_size + Protocol::address_digits;
+    static constexpr char reply_start = Protocol::reply_start; // to resynchronise on a byte stream
+    // the data field is two's complement, anything outside this range does not fit
+    static constexpr qint64 min_value = -(Q_INT64_C(1) << (4 * Protocol::data_digits - 1));
+    static constexpr qint64 max_value = (Q_INT64_C(1) << (4 * Protocol::data_digits - 1)) - 1;
+
+    // value already scaled to the wire, false also for NaN
+    static constexpr bool fitsData(double value) {
+        return value >= min_value && value <= max_value;
+    }
+
+    static constexpr const ProtocolCommand *command(int code) {
+        for (const ProtocolCommand &entry : Protocol::command_table) {
+            if (entry.command == code) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    static constexpr double scale(int code) {
+        const ProtocolCommand *entry = command(code);
+        return entry ? entry->scale : 1.0;
+    }
+
+    // out must hold request_size bytes, returns the frame length
+    static int encodeRequest(int code, int value, char *out) {
+        char *end = out;
+        *end++ = Protocol::request_start;
+        end = writeDecimal(end, code, Protocol::command_digits);
+        end = writeHex(end, value, Protocol::data_digits);
+        end = writeHex(end, Protocol::checksum(out + 1, end - out - 1), Protocol::checksum_digits);
+        *end++ = Protocol::request_end;
+        return end - out;
+    }
+
+    // out must hold addressed_request_size bytes, returns the frame length
+    static int encodeAddressedRequest(int address, int code, int value, char *out) {
+        char *end = out;
+        *end++ = Protocol::request_start;
+        end = writeHex(end, address, Protocol::address_digits);
+        end = writeDecimal(end, code, Protocol::command_digits);
+        end = writeHex(end, value, Protocol::data_digits);
+        end = writeHex(end, Protocol::checksum(out + 1, end - out - 1), Protocol::checksum_digits);
+        *end++ = Protocol::request_end;
+        return end - out;
+    }
+
+    // out must hold addressed_reply_size bytes, returns the frame length
+    static int encodeAddressedReply(int address, int value, char *out) {
+        char *end = out;
+        *end++ = Protocol::reply_start;
+        end = writeHex(end, address, Protocol::address_digits);
+        end = writeHex(end, value, Protocol::data_digits);
+        end = writeHex(end, Protocol::checksum(out + 1, end - out - 1), Protocol::checksum_digits);
+        *end++ = Protocol::reply_end;
+        return end - out;
+    }
+
+    // out must hold reply_size bytes, returns the frame length
+    static int encodeReply(int value, char *out) {
+        char *end = out;
+        *end++ = Protocol::reply_start;
+        end = writeHex(end, value, Protocol::data_digits);
+        end = writeHex(end, Protocol::checksum(out + 1, end - out - 1), Protocol::checksum_digits);
+        *end++ = Protocol::reply_end;
+        return end - out;
+    }
+
+    // value is the data field, sign extended
+    static int decodeReply(const char *data, int length, int &value) {
+        if (length < reply_size) {
+            return INCOMPLETE;
+        }
+        if (length > reply_size || data[0] != Protocol::reply_start || data[reply_size-1] != Protocol::reply_end) {
+            return MALFORMED;
+        }
+        int checksum = 0;
+        if (!readHex(data + 1, Protocol::data_digits, value)
+                || !readHex(data + 1 + Protocol::data_digits, Protocol::checksum_digits, checksum)) {
+            return MALFORMED;
+        }
+        value = signExtend(value);
+        return checksumMatches(data + 1, Protocol::data_digits, checksum) ? VALID : BAD_CHECKSUM;
+    }
+
+    // address is only valid when the result is VALID or BAD_CHECKSUM
+    static int decodeAddressedReply(const char *data, int length, int &address, int &value) {
+        if (length < addressed_reply_size) {
+            return INCOMPLETE;
+        }
+        if (length > addressed_reply_size || data[0] != Protocol::reply_start
+                || data[addressed_reply_size-1] != Protocol::reply_end) {
+            return MALFORMED;
+        }
+        const char *field = data + 1;
+        int checksum = 0;
+        if (!readHex(field, Protocol::address_digits, address)
+                || !readHex(field + Protocol::address_digits, Protocol::data_digits, value)
+                || !readHex(field + Protocol::address_digits + Protocol::data_digits,
+                            Protocol::checksum_digits, checksum)) {
+            return MALFORMED;
+        }
+        value = signExtend(value);
+        return checksumMatches(field, Protocol::address_digits + Protocol::data_digits, checksum)
+                ? VALID : BAD_CHECKSUM;
+    }
+
+    static int decodeRequest(const char *data, int length, int &code, int &value) {
+        if (length < request_size) {
+            return INCOMPLETE;
+        }
+        if (length > request_size || data[0] != Protocol::request_start
+                || data[request_size-1] != Protocol::request_end) {
+            return MALFORMED;
+        }
+        const char *field = data + 1;
+        int checksum = 0;
+        if (!readDecimal(field, Protocol::command_digits, code)
+                || !readHex(field + Protocol::command_digits, Protocol::data_digits, value)
+                || !readHex(field + Protocol::command_digits + Protocol::data_digits,
+                            Protocol::checksum_digits, checksum)) {
+            return MALFORMED;
+        }
+        value = signExtend(value);
+        return checksumMatches(field, Protocol::command_digits + Protocol::data_digits, checksum)
+                ? VALID : BAD_CHECKSUM;
+    }
+
+private:
+    static constexpr quint32 digit_mask(int digits) {
+        return digits >= 8 ? 0xffffffffu : (1u << (4 * digits)) - 1;
+    }
+
+    static bool checksumMatches(const char *data, int length, int checksum) {
+        return (Protocol::checksum(data, length) & digit_mask(Protocol::checksum_digits)) == (quint32)checksum;
+    }
+
+    static char *writeDecimal(char *out, int value, int digits) {
+        for (int i=digits-1; i>=0; i--) {
+            out[i] = '0' + value % 10;
+            value /= 10;
+        }
+        return out + digits;
+    }
+
+    // lower case, fixed width, two's complement for negative values; callers range check
+    // data with fitsData, higher digits are dropped
+    static char *writeHex(char *out, quint32 value, int digits) {
+        static const char hex_digits[] = "0123456789abcdef";
+        for (int i=digits-1; i>=0; i--) {
+            out[i] = hex_digits[value & 0xf];
+            value >>= 4;
+        }
+        return out + digits;
+    }
+
+    // the data field as read by readHex back to a signed value
+    static int signExtend(int value) {
+        if (Protocol::data_digits < 8 && (value & (1 << (4 * Protocol::data_digits - 1)))) {
+            value -= 1 << (4 * Protocol::data_digits);
+        }
+        return value;
+    }
+
+    static bool readDecimal(const char *data, int digits, int &value) {
+        value = 0;
+        for (int i=0; i<digits; i++) {
+            if (data[i] < '0' || data[i] > '9') {
+                return false;
+            }
+            value = value * 10 + (data[i] - '0');
+        }
+        return true;
+    }
+
+    static bool readHex(const char *data, int digits, int &value) {
+        value = 0;
+        for (int i=0; i<digits; i++) {
+            const char c = data[i];
+            int digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                digit = c - 'A' + 10;
+            } else {
+                return false;
+            }
+            value = (value << 4) | digit;
+        }
+        return true;
+    }
+};
+
+#endif // PROTOCOLTRAITS_H
@@ -0,0 +1,140 @@
+#ifndef RINGQUEUE_H
+#define RINGQUEUE_H
+
+#include <QVector>
+#include <utility>
+
+// Double ended queue over slots allocated up front. Pushing and popping at either
+// end reuses the slots, so once reserve() has been called a queue that stays within
+// its capacity never touches the heap. It grows like QVector when it has to, which
+// is counted in growCount() so it can be spotted and the capacity raised.
+//
+// Slots are reset to T() when taken out, e.g. a Request gives up its callback.
+template <typename T>
+class RingQueue
+{
+public:
+    explicit RingQueue(int capacity = 0) {
+        reserve(capacity);
+    }
+
+    void reserve(int capacity) {
+        if (capacity > cells.size()) {
+            regrow(capacity);
+        }
+    }
+
+    int capacity() const { return cells.size(); }
+    int growCount() const { return grow_count; }
+    int size() const { return count; }
+    int length() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+    T &operator[](int i) { return cells[index(i)]; }
+    const T &operator[](int i) const { return cells[index(i)]; }
+    const T &at(int i) const { return cells[index(i)]; }
+    T &first() { return cells[front]; }
+    const T &first() const { return cells[front]; }
+    T &head() { return first(); }
+    const T &head() const { return first(); }
+    T &last() { return cells[index(count - 1)]; }
+    const T &last() const { return cells[index(count - 1)]; }
+
+    void enqueue(T value) {
+        makeRoom();
+        cells[index(count)] = std::move(value);
+        count++;
+    }
+    void append(T value) { enqueue(std::move(value)); }
+
+    void prepend(T value) {
+        makeRoom();
+        front = front == 0 ? cells.size() - 1 : front - 1;
+        cells[front] = std::move(value);
+        count++;
+    }
+
+    T dequeue() {
+        T value = std::move(cells[front]);
+        cells[front] = T();
+        front = (front + 1) % cells.size();
+        count--;
+        return value;
+    }
+    T takeFirst() { return dequeue(); }
+    void removeFirst() { dequeue(); }
+
+    void removeLast() {
+        cells[index(count - 1)] = T();
+        count--;
+    }
+
+    T takeAt(int i) {
+        T value = std::move(cells[index(i)]);
+        // close the gap from whichever end is nearer
+        if (i < count / 2) {
+            for (int j=i; j>0; j--) {
+                cells[index(j)] = std::move(cells[index(j - 1)]);
+            }
+            cells[front] = T();
+            front = (front + 1) % cells.size();
+        } else {
+            for (int j=i; j<count-1; j++) {
+                cells[index(j)] = std::move(cells[index(j + 1)]);
+            }
+            cells[index(count - 1)] = T();
+        }
+        count--;
+        return value;
+    }
+
+    void clear() {
+        for (int i=0; i<count; i++) {
+            cells[index(i)] = T();
+        }
+        front = 0;
+        count = 0;
+    }
+
+    class const_iterator {
+    public:
+        const_iterator(const RingQueue *queue, int i) : queue(queue), i(i) {}
+        const T &operator*() const { return queue->at(i); }
+        const_iterator &operator++() { i++; return *this; }
+        bool operator!=(const const_iterator &other) const { return i != other.i; }
+    private:
+        const RingQueue *queue;
+        int i;
+    };
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+private:
+    int index(int i) const {
+        int slot = front + i;
+        return slot >= cells.size() ? slot - cells.size() : slot;
+    }
+
+    void makeRoom() {
+        if (count == cells.size()) {
+            grow_count++;
+            regrow(qMax(4, cells.size() * 2));
+        }
+    }
+
+    void regrow(int capacity) {
+        QVector<T> grown(capacity);
+        for (int i=0; i<count; i++) {
+            grown[i] = std::move(cells[index(i)]);
+        }
+        cells.swap(grown);
+        front = 0;
+    }
+
+    QVector<T> cells;
+    int front = 0;
+    int count = 0;
+    int grow_count = 0;
+};
+
+#endif // RINGQUEUE_H
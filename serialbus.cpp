@@ -0,0 +1,376 @@
+#include "serialbus.h"
+#include "serialcomm.h"
+#include <QRegExp>
+#include <string.h>
+
+SerialBus::SerialBus(QObject *parent) : QObject(parent) {
+    connect(&port, &QSerialPort::readyRead, this, &SerialBus::readReplies);
+    connect(&port, &QSerialPort::errorOccurred, this, &SerialBus::portError);
+    gap_timer.setSingleShot(true);
+    gap_timer.setCallback([this]() { schedule(); });
+    reply_timer.setSingleShot(true);
+    reply_timer.setCallback([this]() { replyTimeout(); });
+}
+
+SerialBus::~SerialBus() {
+    close();
+}
+
+void SerialBus::addLink(quint8 address, SerialComm *link) {
+    removeLink(address);
+    if (link->isOpen()) {
+        link->closeSerialPort();
+    }
+    link->setBackend(SerialComm::BUS_BACKEND);
+    link->bus = this;
+
+    Drop drop;
+    drop.link = link;
+    drop.address = address;
+    int i = 0;
+    while (i < drops.length() && drops[i].address < address) {
+        i++;
+    }
+    drops.insert(i, drop);
+    if (in_flight >= i) {
+        in_flight++;
+    }
+}
+
+void SerialBus::removeLink(quint8 address) {
+    for (int i=0; i<drops.length(); i++) {
+        if (drops[i].address != address) {
+            continue;
+        }
+        if (SerialComm *link = drops[i].link) {
+            if (link->isOpen()) {
+                link->closeSerialPort();
+            }
+            link->bus = nullptr;
+            link->setBackend(SerialComm::QT_BACKEND);
+        }
+        if (in_flight == i) {
+            // its reply, if any, is read as stale
+            finishTransaction();
+        } else if (in_flight > i) {
+            in_flight--;
+        }
+        drops.removeAt(i);
+        last_served = -1;
+        return;
+    }
+}
+
+SerialComm *SerialBus::link(quint8 address) const {
+    for (const Drop &drop : drops) {
+        if (drop.address == address) {
+            return drop.link;
+        }
+    }
+    return nullptr;
+}
+
+bool SerialBus::open(const SettingsDialog::Settings &settings) {
+    if (port.isOpen()) {
+        return true;
+    }
+    port.setPortName(settings.name);
+    port.setBaudRate(settings.baudRate);
+    port.setDataBits(settings.dataBits);
+    port.setParity(settings.parity);
+    port.setStopBits(settings.stopBits);
+    port.setFlowControl(settings.flowControl);
+    if (!port.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    qDebug() << "RS-485 bus on" << settings.name << "with" << drops.length() << "controllers";
+
+    in_flight = -1;
+    receive_length = 0;
+    counters = BusStats();
+    busy_ns = 0;
+    opened_ns = SerialComm::monotonicNs();
+    line_idle_ns = opened_ns;
+    return true;
+}
+
+void SerialBus::close() {
+    gap_timer.stop();
+    reply_timer.stop();
+    for (Drop &drop : drops) {
+        drop.waiting = false;
+        SerialComm *link = drop.link;
+        if (link && link->bus == this && link->isOpen()) {
+            link->closeSerialPort();
+        }
+    }
+    in_flight = -1;
+    if (port.isOpen()) {
+        port.close();
+    }
+}
+
+bool SerialBus::isOpen() const {
+    return port.isOpen();
+}
+
+QString SerialBus::portName() const {
+    return port.portName();
+}
+
+QString SerialBus::errorString() const {
+    return port.errorString();
+}
+
+void SerialBus::setTurnaroundGap(int gap_us) {
+    turnaround_gap_us = qMax(0, gap_us);
+}
+
+int SerialBus::turnaroundGap() const {
+    if (turnaround_gap_us > 0) {
+        return turnaround_gap_us;
+    }
+    // Modbus RTU uses the same 3.5 characters, ten bits each with start and stop
+    return (int)(3.5 * 10 * 1000000.0 / qMax<qint32>(port.baudRate(), 1200));
+}
+
+void SerialBus::setReplyTimeout(int timeout_ms) {
+    reply_timeout_ms = timeout_ms;
+}
+
+void SerialBus::setMaxPasses(int passes) {
+    max_passes = qMax(1, passes);
+}
+
+SerialBus::BusStats SerialBus::stats() const {
+    BusStats result = counters;
+    const qint64 elapsed_ns = SerialComm::monotonicNs() - opened_ns;
+    if (port.isOpen() && elapsed_ns > 0) {
+        qint64 busy = busy_ns;
+        if (in_flight != -1) {
+            busy += SerialComm::monotonicNs() - transaction_start_ns;
+        }
+        result.utilization = (double)busy / elapsed_ns;
+    }
+    return result;
+}
+
+bool SerialBus::parseBusName(const QString &name, QString &port_name, quint8 &address) {
+    QRegExp bus_regex("^rs485://(.+)/(\\d+)$");
+    if (!bus_regex.exactMatch(name) || bus_regex.cap(2).toUInt() > 255) {
+        return false;
+    }
+    port_name = bus_regex.cap(1);
+    address = (quint8)bus_regex.cap(2).toUInt();
+    return true;
+}
+
+//Private
+void SerialBus::submit(SerialComm *link) {
+    const int i = dropIndex(link);
+    if (i == -1) {
+        return;
+    }
+    // one frame per link, a newer one replaces a frame whose request has since timed out
+    drops[i].waiting = true;
+    drops[i].tag = link->bus_tag;
+    drops[i].priority = link->current_request.priority;
+    schedule();
+}
+
+void SerialBus::withdraw(SerialComm *link) {
+    const int i = dropIndex(link);
+    if (i != -1) {
+        drops[i].waiting = false;
+        drops[i].passes = 0;
+    }
+}
+
+int SerialBus::dropIndex(const SerialComm *link) const {
+    for (int i=0; i<drops.length(); i++) {
+        const SerialComm *candidate = drops[i].link;
+        if (candidate == link) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int SerialBus::urgency(const Drop &drop) const {
+    // SAFETY is never held back, a frame passed over often enough goes before the rest
+    if (drop.priority == SerialComm::SAFETY) {
+        return 0;
+    }
+    return drop.passes >= max_passes ? 1 : drop.priority + 1;
+}
+
+void SerialBus::schedule() {
+    if (in_flight != -1 || !port.isOpen() || drops.isEmpty()) {
+        return;
+    }
+
+    // most urgent first, round robin from the link after the last one served
+    int next = -1;
+    for (int n=1; n<=drops.length(); n++) {
+        const int i = (last_served + n) % drops.length();
+        if (drops[i].waiting && (next == -1 || urgency(drops[i]) < urgency(drops[next]))) {
+            next = i;
+        }
+    }
+    if (next == -1) {
+        return;
+    }
+
+    const qint64 wait_ns = line_idle_ns + (qint64)turnaroundGap() * 1000 - SerialComm::monotonicNs();
+    if (wait_ns > 0) {
+        if (!gap_timer.isActive()) {
+            gap_timer.start((int)((wait_ns + 999999) / 1000000));
+        }
+        return;
+    }
+    transmit(next);
+}
+
+void SerialBus::transmit(int index) {
+    Drop &drop = drops[index];
+    drop.waiting = false;
+    drop.passes = 0;
+    SerialComm *link = drop.link;
+    if (!link || !link->request_active || link->bus_tag != drop.tag) {
+        schedule(); // given up on in the meantime
+        return;
+    }
+    // turns among equals come round anyway, only being overtaken by more urgent frames counts
+    for (Drop &other : drops) {
+        if (other.waiting && other.priority > drop.priority) {
+            other.passes++;
+        }
+    }
+
+    char frame[max_frame];
+    const int length = encodeRequest(drop.address, link->current_request.command,
+                                     link->current_request.value, frame);
+    port.clear(QSerialPort::Input); // whatever is left of an earlier answer
+    receive_length = 0;
+    if (port.write(frame, length) != length) {
+        link->sendError(QSerialPort::WriteError, "RS-485 bus: " + port.errorString());
+        schedule();
+        return;
+    }
+    qCDebug(serialFrames) << "bus" << drop.address << QByteArray(frame, length);
+
+    in_flight = index;
+    in_flight_tag = drop.tag;
+    last_served = index;
+    transaction_start_ns = SerialComm::monotonicNs();
+    link->current_request.times.sent_ns = transaction_start_ns;
+    counters.transactions++;
+    // the link's own timeout only counts from here, waiting for the line is not the card's fault
+    if (link->bus_timeout_ms > 0) {
+        link->timeout_timer.start(link->bus_timeout_ms);
+        link->bus_timeout_ms = 0;
+    }
+    // shorter than the link's, this one is what frees the bus
+    reply_timer.start(reply_timeout_ms);
+}
+
+void SerialBus::readReplies() {
+    const qint64 read_ns = SerialComm::monotonicNs();
+    while (port.bytesAvailable() > 0) {
+        const qint64 count = port.read(receive_buffer + receive_length, sizeof(receive_buffer) - receive_length);
+        if (count <= 0) {
+            break;
+        }
+        receive_length += count;
+
+        while (receive_length > 0) {
+            int address = 0;
+            int value = 0;
+            const int result = decodeReply(receive_buffer, receive_length, address, value);
+            if (result == INCOMPLETE) {
+                break;
+            }
+            if (result == MALFORMED) {
+                // resynchronise on the next start byte
+                counters.bad_frames++;
+                const char *start = (const char*)memchr(receive_buffer + 1, replyStart(), receive_length - 1);
+                const int skip = start ? start - receive_buffer : receive_length;
+                receive_length -= skip;
+                memmove(receive_buffer, receive_buffer + skip, receive_length);
+                continue;
+            }
+
+            char reply[max_frame];
+            const int reply_length = encodeLinkReply(value, reply);
+            const int frame_length = replySize();
+            receive_length -= frame_length;
+            memmove(receive_buffer, receive_buffer + frame_length, receive_length);
+
+            if (in_flight == -1 || drops[in_flight].address != address) {
+                counters.stale_replies++;
+                qCDebug(serialFrames) << "bus: dropped a reply from" << address;
+                continue;
+            }
+            SerialComm *link = drops[in_flight].link;
+            const bool current = link && link->request_active && link->bus_tag == in_flight_tag;
+            finishTransaction();
+            if (current) {
+                if (result == VALID) {
+                    // the address is checked, the link sees its frame as on a port of its own
+                    link->relayFrame(reply, reply_length, read_ns);
+                } else {
+                    link->sendError(QSerialPort::ParityError, "Checksum mismatched");
+                }
+            }
+        }
+    }
+    schedule();
+}
+
+void SerialBus::finishTransaction() {
+    reply_timer.stop();
+    const qint64 now = SerialComm::monotonicNs();
+    if (transaction_start_ns != 0) {
+        busy_ns += now - transaction_start_ns;
+        transaction_start_ns = 0;
+    }
+    in_flight = -1;
+    line_idle_ns = now;
+}
+
+void SerialBus::replyTimeout() {
+    if (in_flight == -1) {
+        return;
+    }
+    counters.timeouts++;
+    SerialComm *link = drops[in_flight].link;
+    // the interlock stops timeout_timer and resends on its own timer
+    const bool current = link && link->request_active && link->bus_tag == in_flight_tag
+            && link->timeout_timer.isActive();
+    finishTransaction();
+    if (current) {
+        // retried by the link without waiting out its own timeout
+        link->timeout_timer.stop();
+        link->timeout();
+    }
+    schedule();
+}
+
+void SerialBus::portError(QSerialPort::SerialPortError error) {
+    if (error == QSerialPort::NoError) {
+        return;
+    }
+    const QString message = "RS-485 bus: " + port.errorString();
+    port.clearError();
+    emit errorSignal(error, message);
+    if (error == QSerialPort::ResourceError) {
+        // adapter unplugged, every controller on it is gone
+        for (Drop &drop : drops) {
+            SerialComm *link = drop.link;
+            if (link && link->bus == this && link->isOpen()) {
+                link->sendError(error, message);
+            }
+        }
+        close();
+    }
+}
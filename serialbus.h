@@ -0,0 +1,124 @@
+#ifndef SERIALBUS_H
+#define SERIALBUS_H
+
+#include <QObject>
+#include <QList>
+#include <QPointer>
+#include <QSerialPort>
+#include "settingsdialog.h"
+#include "timerwheel.h"
+
+class SerialComm;
+
+// Several controllers on one RS-485 bus behind a single adapter. Each one is a
+// SerialComm of its own, with its own queues (and for an oven its cache, alarms and
+// interlock), whose frames go through the bus instead of a port
+// (SerialComm::BUS_BACKEND). The bus is half duplex, so it carries one transaction at
+// a time:
+//
+//  - every controller has at most one frame waiting, the one its own scheduler picked next
+//  - the most urgent waiting frame goes first, controllers of the same priority take turns
+//  - a frame overtaken by more urgent ones max_passes times goes next, ahead of
+//    anything but SAFETY, so a card that only polls is not starved by a busy neighbour
+//  - after each reply or timeout the line is left idle for the turnaround gap, so
+//    the controller that answered has released the driver before anyone transmits
+//  - a reply is routed by the address it carries, one from a controller that is not
+//    being asked (a late answer to a timed out request) is dropped
+//
+// The link's reply timeout starts when its frame goes out, not while it waits for the
+// line. The framing comes from the codec, see OvenBus. A station opens ovens on ports
+// named rs485://port/address, e.g. rs485://ttyUSB0/3, and shares one bus per port.
+class SerialBus : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct BusStats {
+        qint64 transactions = 0;
+        qint64 timeouts = 0;
+        qint64 stale_replies = 0; // from a controller other than the one asked
+        qint64 bad_frames = 0;
+        double utilization = 0.0; // share of the time since open() with a transaction on the line
+    };
+
+    explicit SerialBus(QObject *parent = nullptr);
+    ~SerialBus();
+
+    // the link is switched to BUS_BACKEND and opens once the bus is open
+    void addLink(quint8 address, SerialComm *link);
+    void removeLink(quint8 address);
+    SerialComm *link(quint8 address) const;
+
+    bool open(const SettingsDialog::Settings &settings); // settings.name is the adapter
+    void close(); // closes the links too
+    bool isOpen() const;
+    QString portName() const;
+    QString errorString() const;
+
+    void setTurnaroundGap(int gap_us); // 0, the default, is 3.5 character times at the baud rate
+    int turnaroundGap() const;
+    void setReplyTimeout(int timeout_ms);
+    void setMaxPasses(int passes);
+    BusStats stats() const;
+
+    // rs485://port/address, false if name is not one
+    static bool parseBusName(const QString &name, QString &port_name, quint8 &address);
+
+signals:
+    void errorSignal(QSerialPort::SerialPortError error, QString error_string);
+
+protected:
+    // FrameCodec::results, the same for every protocol
+    enum results { INCOMPLETE=0, VALID=1, BAD_CHECKSUM=2, MALFORMED=3 };
+    static const int max_frame = 64;
+
+    // Framing of the codec, out holds max_frame bytes and lengths are returned
+    virtual int encodeRequest(int address, int command, int value, char *out) const = 0;
+    virtual int decodeReply(const char *data, int length, int &address, int &value) const = 0;
+    virtual int encodeLinkReply(int value, char *out) const = 0; // as the link would read it off a port
+    virtual int replySize() const = 0; // addressed
+    virtual char replyStart() const = 0;
+
+private:
+    friend class SerialComm;
+
+    struct Drop {
+        QPointer<SerialComm> link;
+        quint8 address = 0;
+        bool waiting = false; // has a frame for the bus
+        quint32 tag = 0;      // the link's bus_tag when it was handed over
+        int priority = 0;
+        int passes = 0;       // times a more urgent frame went first while this one waited
+    };
+
+    void submit(SerialComm *link);
+    void withdraw(SerialComm *link);
+    int dropIndex(const SerialComm *link) const;
+    int urgency(const Drop &drop) const;
+    void schedule();
+    void transmit(int index);
+    void readReplies();
+    void finishTransaction();
+    void replyTimeout();
+    void portError(QSerialPort::SerialPortError error);
+
+    QSerialPort port;
+    QList<Drop> drops; // in address order
+    int in_flight = -1; // index of the drop being asked, -1 while the line is idle
+    quint32 in_flight_tag = 0;
+    int last_served = -1;
+    qint64 transaction_start_ns = 0;
+    qint64 line_idle_ns = 0; // when the last transaction ended
+    int turnaround_gap_us = 0;
+    int reply_timeout_ms = 250;
+    int max_passes = 4;
+    WheelTimer gap_timer;
+    WheelTimer reply_timer;
+    char receive_buffer[max_frame];
+    int receive_length = 0;
+    BusStats counters;
+    qint64 busy_ns = 0;
+    qint64 opened_ns = 0;
+};
+
+#endif // SERIALBUS_H
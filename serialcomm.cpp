@@ -1,42 +1,172 @@
 #include "serialcomm.h"
+#include "allocationcounter.h"
+#include "gatewayprotocol.h"
+#include "latencytrace.h"
+#include "serialbus.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaMethod>
+#include <QRegExp>
+#include <QVarLengthArray>
+#include <atomic>
+#include <chrono>
+#include <time.h>
+
+#ifdef Q_OS_LINUX
+#include "epollserialloop.h"
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+static speed_t toSpeed(qint32 baud_rate) {
+    switch (baud_rate) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+    }
+    return B0;
+}
+#endif
+
+Q_LOGGING_CATEGORY(serialFrames, "ovencomm.frames", QtInfoMsg)
 
 SerialComm::SerialComm(QObject *parent) : QObject(parent)
 {
+    static std::atomic<int> links(0);
+    trace_link = links++;
     connect(&serial_conn, &QSerialPort::errorOccurred, this, &SerialComm::collectErrorData);
-    connect(&timeout_timer, &QTimer::timeout, this, &SerialComm::timeout);
+    connect(&serial_conn, &QSerialPort::bytesWritten, this, &SerialComm::collectBytesWritten);
+    connect(&gateway_conn, &QTcpSocket::connected, this, &SerialComm::gatewayConnected);
+    connect(&gateway_conn, &QTcpSocket::readyRead, this, &SerialComm::gatewayReadyRead);
+    connect(&gateway_conn, &QTcpSocket::errorOccurred, this, &SerialComm::gatewayError);
+    qRegisterMetaType<SerialComm::FrameTimes>();
+    timeout_timer.setCallback([this]() { timeout(); });
     timeout_timer.setSingleShot(true);
     send_message_timer.setInterval(250);
+    raw_data_text.reserve(receive_capacity);
+
+    // Commands are never dropped silently, only background reads are shed
+    setQueueLimit(SAFETY, 8, REJECT_NEW);
+    setQueueLimit(SET, 32, REJECT_NEW);
+    setQueueLimit(INTERACTIVE, 32, DROP_OLDEST);
+    setQueueLimit(POLLING, 16, DROP_OLDEST);
+}
+
+SerialComm::~SerialComm() {
+    // nothing may call back into a destroyed link, the subclass is already gone
+    if (tuning_saved) {
+        setLowLatencyTuning(false);
+    }
+    closeEpollPort();
+    gateway_conn.disconnect(this);
+    gateway_open = false;
+    gateway_connecting = false;
+    gateway_conn.abort();
+    if (bus) {
+        bus->withdraw(this);
+    }
 }
 
 void SerialComm::openSerialPort() {
-    if (serial_conn.open(QIODevice::ReadWrite)) {
+    bool opened;
+    if (serial_backend == EPOLL_BACKEND) {
+        opened = openEpollPort();
+    } else if (serial_backend == TCP_BACKEND) {
+        opened = openGatewayConn();
+    } else if (serial_backend == BUS_BACKEND) {
+        // the bus owns the port, the line settings and the low latency tuning
+        bus_open = bus && bus->isOpen();
+        opened = bus_open;
+        if (!opened) {
+            sendError(QSerialPort::NotOpenError, "RS-485 bus is not open");
+        }
+    } else {
+        opened = serial_conn.open(QIODevice::ReadWrite);
+    }
+
+    if (opened) {
         QString successMessage = QString("Connected to %1 : %2, %3, %4, %5, %6")
                 .arg(serial_conn.portName()).arg(serial_conn.baudRate())
                 .arg(serial_conn.dataBits()).arg(serial_conn.parity())
                 .arg(serial_conn.stopBits()).arg(serial_conn.flowControl());
         qDebug() << successMessage;
+        if (low_latency && serial_backend != TCP_BACKEND && serial_backend != BUS_BACKEND) {
+            setLowLatencyTuning(true);
+        } else if (tuning_saved) {
+            setLowLatencyTuning(false);
+        }
         send_message_timer.start();
     }
 }
 
 void SerialComm::closeSerialPort() {
-    // Reset data related vars
-    command_queue.clear();
-    data_queue.clear();
-    temp_data = "";
-    timeout_timer.stop();
+    // Reset data related vars, callbacks run last so they see a closed link
+    QList<Request> abandoned;
+    if (request_active) {
+        abandoned.append(current_request);
+    }
+    for (int i=0; i<PRIORITY_COUNT; i++) {
+        while (!command_queue[i].isEmpty()) {
+            abandoned.append(command_queue[i].dequeue());
+        }
+    }
+    request_active = false;
+    group_priority = -1;
+    low_latency_applied = false;
+    receive_length = 0;
+    stopReplyTimeout();
     send_message_timer.stop();
 
     if (isOpen()) {
-        serial_conn.clear();
-        serial_conn.close();
+        // the tuning is system wide, the adapter goes back to how we found it
+        if (tuning_saved) {
+            setLowLatencyTuning(false);
+        }
+        clearSerialData();
+        if (serial_backend == EPOLL_BACKEND) {
+            closeEpollPort();
+        } else if (serial_backend == TCP_BACKEND) {
+            gateway_open = false;
+            gateway_connecting = false;
+            gateway_conn.abort();
+        } else if (serial_backend == BUS_BACKEND) {
+            bus_open = false;
+            if (bus) {
+                bus->withdraw(this);
+            }
+        } else {
+            serial_conn.close();
+        }
         qDebug() << "Disconnected";
     } else {
         qDebug() << "No open connection";
     }
+
+    for (Request &request : abandoned) {
+        completeRequest(request, false, 0, QSerialPort::NotOpenError);
+    }
 }
 
 bool SerialComm::isOpen() {
+    if (serial_backend == EPOLL_BACKEND) {
+        return port_fd != -1;
+    } else if (serial_backend == TCP_BACKEND) {
+        return gateway_open; // until closeSerialPort, like a tty whose adapter was pulled
+    } else if (serial_backend == BUS_BACKEND) {
+        return bus_open;
+    }
     return serial_conn.isOpen();
 }
 
@@ -47,6 +177,25 @@ void SerialComm::updateSerialInfo(const SettingsDialog::Settings &settings) {
     serial_conn.setParity(settings.parity);
     serial_conn.setStopBits(settings.stopBits);
     serial_conn.setFlowControl(settings.flowControl);
+    low_latency = settings.lowLatency;
+
+    if (isOpen()) {
+        if (!low_latency && tuning_saved) {
+            setLowLatencyTuning(false);
+        }
+        return;
+    }
+    QRegExp gateway_regex("^tcp://([^:/]+):(\\d+)(?:/(\\d+))?$");
+    if (gateway_regex.exactMatch(settings.name)) {
+        gateway_host = gateway_regex.cap(1);
+        gateway_port = gateway_regex.cap(2).toUShort();
+        gateway_oven = gateway_regex.cap(3).toUShort();
+        serial_backend = TCP_BACKEND;
+    } else if (isBusName(settings.name)) {
+        // SerialBus::addLink selects BUS_BACKEND, the settings are the bus's
+    } else if (serial_backend == TCP_BACKEND || serial_backend == BUS_BACKEND) {
+        serial_backend = QT_BACKEND;
+    }
 }
 
 void SerialComm::startSendMessageTimer() {
@@ -55,7 +204,795 @@ void SerialComm::startSendMessageTimer() {
     }
 }
 
+void SerialComm::setQueueLimit(int priority, int limit, int overflow_policy) {
+    queue_limit[priority] = limit;
+    queue_overflow_policy[priority] = overflow_policy;
+    // one more than the limit, a timed out or preempted request is put back at the front
+    command_queue[priority].reserve(limit + 1);
+}
+
+bool SerialComm::hasPendingRequest(int command) const {
+    if (request_active && current_request.command == command) {
+        return true;
+    }
+    for (int i=0; i<PRIORITY_COUNT; i++) {
+        for (int j=0; j<command_queue[i].length(); j++) {
+            if (command_queue[i][j].command == command) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void SerialComm::setSendInterval(int interval_ms) {
+    send_message_timer.setInterval(interval_ms);
+}
+
+qint64 SerialComm::lastRoundTripUs() const {
+    return last_round_trip_us;
+}
+
+bool SerialComm::setLowLatencyTuning(bool enable) {
+    // disabling puts back what was there before enabling, the settings outlive the open port
+    low_latency_applied = false;
+    if (!isOpen() || serial_backend == TCP_BACKEND || serial_backend == BUS_BACKEND) {
+        return false;
+    }
+#ifdef Q_OS_LINUX
+    if (!enable && !tuning_saved) {
+        return true; // never tuned, nothing to put back
+    }
+    if (enable && !tuning_saved) {
+        saved_tuning = LatencyTuning(); // what cannot be read is assumed to be the default
+        readLatencyTuning(saved_tuning);
+    }
+
+    // the driver pushes received bytes up immediately instead of batching them, the fd
+    // is non-blocking and read on readiness so there is no inter-byte timer or minimum
+    // count, and FTDI adapters hold data for 1 ms instead of up to 16
+    LatencyTuning tuned = saved_tuning;
+    tuned.async_low_latency = true;
+    tuned.vmin = 0;
+    tuned.vtime = 0;
+    tuned.latency_timer = "1";
+    bool applied = applyLatencyTuning(enable ? tuned : saved_tuning);
+
+    // kept until a disable, a reopened port must not take the tuned values as the originals
+    tuning_saved = enable;
+    low_latency_applied = enable && applied;
+    return applied;
+#else
+    Q_UNUSED(enable);
+    qDebug() << "Low latency mode is only available on Linux";
+    return false;
+#endif
+}
+
+bool SerialComm::readLatencyTuning(LatencyTuning &tuning) {
+    if (!isOpen() || serial_backend == TCP_BACKEND || serial_backend == BUS_BACKEND) {
+        return false;
+    }
+#ifdef Q_OS_LINUX
+    int fd = serialHandle();
+    bool read = true;
+    struct serial_struct serial_info;
+    if (ioctl(fd, TIOCGSERIAL, &serial_info) == 0) {
+        tuning.async_low_latency = serial_info.flags & ASYNC_LOW_LATENCY;
+    } else {
+        qDebug() << "TIOCGSERIAL not supported";
+        read = false;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        tuning.vmin = tio.c_cc[VMIN];
+        tuning.vtime = tio.c_cc[VTIME];
+    } else {
+        read = false;
+    }
+
+    QFile latency_timer(QString("/sys/bus/usb-serial/devices/%1/latency_timer")
+                        .arg(QFileInfo(serial_conn.portName()).fileName()));
+    if (latency_timer.exists()) {
+        if (latency_timer.open(QIODevice::ReadOnly)) {
+            tuning.latency_timer = latency_timer.readAll().trimmed();
+        } else {
+            read = false;
+        }
+    }
+    return read;
+#else
+    Q_UNUSED(tuning);
+    return false;
+#endif
+}
+
+bool SerialComm::applyLatencyTuning(const LatencyTuning &tuning) {
+    if (!isOpen() || serial_backend == TCP_BACKEND || serial_backend == BUS_BACKEND) {
+        return false;
+    }
+#ifdef Q_OS_LINUX
+    int fd = serialHandle();
+    bool applied = true;
+    struct serial_struct serial_info;
+    if (ioctl(fd, TIOCGSERIAL, &serial_info) == 0) {
+        if (tuning.async_low_latency) {
+            serial_info.flags |= ASYNC_LOW_LATENCY;
+        } else {
+            serial_info.flags &= ~ASYNC_LOW_LATENCY;
+        }
+        if (ioctl(fd, TIOCSSERIAL, &serial_info) != 0) {
+            qDebug() << "ASYNC_LOW_LATENCY not accepted";
+            applied = false;
+        }
+    } else {
+        applied = false;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        tio.c_cc[VMIN] = tuning.vmin;
+        tio.c_cc[VTIME] = tuning.vtime;
+        if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+            applied = false;
+        }
+    } else {
+        applied = false;
+    }
+
+    // a sysfs setting of the adapter, it stays after the port is closed
+    QFile latency_timer(QString("/sys/bus/usb-serial/devices/%1/latency_timer")
+                        .arg(QFileInfo(serial_conn.portName()).fileName()));
+    if (latency_timer.exists()) {
+        if (latency_timer.open(QIODevice::WriteOnly)
+                && latency_timer.write(tuning.latency_timer) == tuning.latency_timer.length()) {
+            qDebug() << "FTDI latency timer set to" << tuning.latency_timer << "ms";
+        } else {
+            qDebug() << "Could not set FTDI latency timer:" << latency_timer.errorString();
+            applied = false;
+        }
+    }
+    return applied;
+#else
+    Q_UNUSED(tuning);
+    return false;
+#endif
+}
+
+qint64 SerialComm::monotonicNs() {
+#ifdef Q_OS_UNIX
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (qint64)now.tv_sec * 1000000000 + now.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool SerialComm::isLowLatency() const {
+    return low_latency_applied;
+}
+
+void SerialComm::setBackend(int backend) {
+    if (isOpen()) {
+        qDebug() << "Backend can only be changed while closed";
+        return;
+    }
+    serial_backend = backend;
+}
+
+int SerialComm::backend() const {
+    return serial_backend;
+}
+
+QString SerialComm::portName() const {
+    return serial_conn.portName();
+}
+
+SerialBus *SerialComm::sharedBus() const {
+    return bus;
+}
+
+bool SerialComm::isGatewayName(const QString &name) {
+    return name.startsWith("tcp://");
+}
+
+bool SerialComm::isBusName(const QString &name) {
+    return name.startsWith("rs485://");
+}
+
+void SerialComm::sendPending() {
+    sendMessage();
+}
+
+SerialComm::PoolStats SerialComm::poolStats() const {
+    PoolStats stats;
+    for (int i=0; i<PRIORITY_COUNT; i++) {
+        stats.request_slots += command_queue[i].capacity();
+        stats.requests_queued += command_queue[i].length();
+        stats.request_pool_grows += command_queue[i].growCount();
+    }
+    stats.receive_capacity = receive_capacity;
+    stats.receive_overflows = receive_overflows;
+    if (AllocationCounter::isEnabled()) {
+        stats.heap_allocations = AllocationCounter::allocations();
+        stats.heap_frees = AllocationCounter::frees();
+    }
+    return stats;
+}
+
+//Protected
+bool SerialComm::enqueueRequest(int command, int value, int priority, const ReplyCallback &callback) {
+    if (!makeRoom(command, priority, 1)) {
+        failRequest(callback, command, QSerialPort::UnknownError);
+        return false;
+    }
+
+    Request request;
+    request.command = command;
+    request.value = value;
+    request.priority = priority;
+    request.callback = callback;
+    request.times.enqueued_ns = monotonicNs();
+    request.times.trace_id = LatencyTrace::nextId();
+    command_queue[priority].enqueue(std::move(request));
+
+    // Safety requests skip send_message_timer when the line is free
+    if (priority == SAFETY && !request_active) {
+        sendMessage();
+    }
+    return true;
+}
+
+bool SerialComm::enqueueLatest(int command, int value, int priority, const ReplyCallback &callback) {
+    // Writes still queued for command are obsolete, their callers get OperationError.
+    // The new one takes the place of the oldest at its own priority, so it is not sent
+    // any later than that one would have been. The request on the wire is left alone
+    // and SAFETY requests are never withdrawn, a power off always goes out.
+    int replace_at = -1;
+    if (priority != SAFETY) {
+        for (int j=0; j<command_queue[priority].length(); j++) {
+            if (command_queue[priority][j].command == command && command_queue[priority][j].group == NO_GROUP) {
+                replace_at = j;
+                break;
+            }
+        }
+    }
+
+    // taken out before any callback runs, a callback may queue again
+    QVarLengthArray<Request, PRIORITY_COUNT> superseded;
+    for (int i=SET; i<PRIORITY_COUNT; i++) {
+        RingQueue<Request> &queue = command_queue[i];
+        for (int j=queue.length()-1; j>=0; j--) {
+            if (queue[j].command == command && queue[j].group == NO_GROUP && !(i == priority && j == replace_at)) {
+                superseded.append(queue.takeAt(j));
+            }
+        }
+    }
+
+    bool queued = true;
+    if (replace_at != -1) {
+        Request &request = command_queue[priority][replace_at];
+        superseded.append(std::move(request));
+        request = Request();
+        request.command = command;
+        request.value = value;
+        request.priority = priority;
+        request.callback = callback;
+        request.times.enqueued_ns = monotonicNs();
+        request.times.trace_id = LatencyTrace::nextId();
+    } else {
+        queued = enqueueRequest(command, value, priority, callback);
+    }
+
+    if (!superseded.isEmpty()) {
+        qCDebug(serialFrames) << "superseded" << superseded.size() << "queued writes of command" << command;
+    }
+    for (int i=0; i<superseded.size(); i++) {
+        completeRequest(superseded[i], false, 0, QSerialPort::OperationError);
+    }
+    return queued;
+}
+
+bool SerialComm::enqueueGroup(const QList<int> &commands, int priority) {
+    // room is made for the whole group at once so it is never split
+    if (commands.isEmpty() || !makeRoom(commands.first(), priority, commands.length())) {
+        return false;
+    }
+
+    for (int i=0; i<commands.length(); i++) {
+        Request request;
+        request.command = commands[i];
+        request.group = (i == commands.length()-1) ? GROUP_END : GROUP_MEMBER;
+        request.priority = priority;
+        request.times.enqueued_ns = monotonicNs();
+        request.times.trace_id = LatencyTrace::nextId();
+        command_queue[priority].enqueue(std::move(request));
+    }
+    return true;
+}
+
+bool SerialComm::takeNextRequest() {
+    // a started group is at the head of its level, so it finishes before anything of
+    // lower urgency, more urgent requests (SAFETY, SET writes) may go between its members.
+    // A group at a more urgent level waits for it, there is one set of group state
+    // (group_priority, OvenComm's pending snapshot) and two open groups would mix it.
+    int priority = -1;
+    for (int i=0; i<PRIORITY_COUNT; i++) {
+        if (command_queue[i].isEmpty()) {
+            continue;
+        }
+        if (group_priority != -1 && i != group_priority && command_queue[i].head().group != NO_GROUP) {
+            continue;
+        }
+        priority = i;
+        break;
+    }
+
+    if (priority == -1) {
+        return false;
+    }
+    current_request = command_queue[priority].dequeue();
+    // a retried request keeps when it was queued, the wire stages start over
+    current_request.times.dequeued_ns = monotonicNs();
+    current_request.times.sent_ns = 0;
+    current_request.times.first_byte_ns = 0;
+    current_request.times.last_byte_ns = 0;
+    current_request.times.decoded_ns = 0;
+    request_active = true;
+    return true;
+}
+
+void SerialComm::finishCurrentRequest() {
+    request_active = false;
+    receive_length = 0;
+
+    if (current_request.group == GROUP_MEMBER) {
+        group_priority = current_request.priority;
+    } else if (current_request.group == GROUP_END) {
+        group_priority = -1;
+    }
+}
+
+bool SerialComm::makeRoom(int command, int priority, int count) {
+    RingQueue<Request> &queue = command_queue[priority];
+    if (queue.length() + count <= queue_limit[priority]) {
+        return true;
+    }
+
+    if (queue_overflow_policy[priority] == REJECT_NEW || count > queue_limit[priority]) {
+        emit errorSignal(QSerialPort::UnknownError, "Command queue full", command);
+        return false;
+    }
+
+    // Shed the oldest entries until count fit, taking whole groups with them
+    while (!queue.isEmpty() && queue.length() + count > queue_limit[priority]) {
+        if (queue.head().group == NO_GROUP) {
+            Request dropped = queue.dequeue();
+            emit requestDropped(dropped.command, priority);
+            completeRequest(dropped, false, 0, QSerialPort::UnknownError);
+        } else {
+            emit requestDropped(queue.head().command, priority);
+            dropGroup(priority);
+        }
+    }
+    return queue.length() + count <= queue_limit[priority];
+}
+
+void SerialComm::dropGroup(int priority) {
+    // discard queued members up to and including the end of the group at the head
+    RingQueue<Request> &queue = command_queue[priority];
+    while (!queue.isEmpty()) {
+        Request dropped = queue.dequeue();
+        completeRequest(dropped, false, 0, QSerialPort::UnknownError);
+        if (dropped.group == GROUP_END || dropped.group == NO_GROUP) {
+            break;
+        }
+    }
+    if (group_priority == priority) {
+        group_priority = -1;
+    }
+    // the in-flight member has lost the rest of its group, let it finish as a plain read
+    if (request_active && current_request.priority == priority && current_request.group == GROUP_MEMBER) {
+        current_request.group = NO_GROUP;
+    }
+}
+
+void SerialComm::completeRequest(Request &request, bool ok, int value, QSerialPort::SerialPortError error) {
+    LatencyTrace::record(trace_link, request.command, ok, request.times);
+    if (!request.callback) {
+        return;
+    }
+    // taken out first so it can never run twice, even if it reenters the link
+    ReplyCallback callback = std::move(request.callback);
+    request.callback = nullptr;
+
+    Reply reply;
+    reply.command = request.command;
+    reply.ok = ok;
+    reply.value = value;
+    reply.error = error;
+    reply.times = request.times;
+    callback(reply);
+}
+
+void SerialComm::failRequest(const ReplyCallback &callback, int command, QSerialPort::SerialPortError error) {
+    if (callback) {
+        Reply reply;
+        reply.command = command;
+        reply.error = error;
+        callback(reply);
+    }
+}
+
+qint64 SerialComm::writeSerialData(const QByteArray &data) {
+    if (serial_backend == TCP_BACKEND) {
+        if (gateway_connecting) {
+            return -1; // stays current, gatewayConnected sends it
+        }
+        if (gateway_conn.state() != QAbstractSocket::ConnectedState) {
+            sendError(QSerialPort::NotOpenError, "No open connection");
+            return -1;
+        }
+        gateway_tag++;
+        char message[GatewayProtocol::request_header + 255];
+        const int length = GatewayProtocol::encodeRequest(message, gateway_tag, gateway_oven, current_request.priority,
+                                                          data.constData(), qMin(data.length(), 255));
+        gateway_conn.write(message, length);
+        // straight to the socket, the event loop would add a pass before the write
+        gateway_conn.flush();
+        current_request.times.sent_ns = monotonicNs();
+        return data.length();
+    }
+
+    if (serial_backend == BUS_BACKEND) {
+        if (!bus_open || !bus) {
+            sendError(QSerialPort::NotOpenError, "No open connection");
+            return -1;
+        }
+        // the bus adds the address and sends it when this controller's turn comes, setting sent_ns;
+        // a frame still waiting from before (e.g. preempted by the interlock) is replaced
+        bus_tag++;
+        bus_timeout_ms = 0;
+        bus->submit(this);
+        return data.length();
+    }
+
+    if (serial_backend != EPOLL_BACKEND) {
+        qint64 written = serial_conn.write(data);
+        // refined by collectBytesWritten once QSerialPort has passed it to the driver
+        current_request.times.sent_ns = monotonicNs();
+        // send QSerialPort::NotOpenError if QOIDevice::NotOpen is triggered
+        if (written == -1 && serial_conn.error() == QSerialPort::NoError) {
+            sendError(QSerialPort::NotOpenError, "No open connection");
+        } //else UNNEEDED as the QSerialPort will emit its own signal for other errors
+        return written;
+    }
+
+#ifdef Q_OS_LINUX
+    if (port_fd == -1) {
+        sendError(QSerialPort::NotOpenError, "No open connection");
+        return -1;
+    }
+    // frames are a few bytes and the tty buffer is kilobytes, a short write is a real error
+    qint64 written = ::write(port_fd, data.constData(), data.length());
+    if (written != data.length()) {
+        sendError(QSerialPort::WriteError, written == -1 ? QString(strerror(errno)) : "Short write");
+        return -1;
+    }
+    current_request.times.sent_ns = monotonicNs();
+    return written;
+#else
+    return -1;
+#endif
+}
+
+int SerialComm::readSerialData(char *out, int capacity) {
+    int stored = 0;
+    bool discarded = false;
+    char scratch[64];
+
+    if (serial_backend == TCP_BACKEND || serial_backend == BUS_BACKEND) {
+        stored = qMin(gateway_frame_length, capacity);
+        memcpy(out, gateway_frame, stored);
+        discarded = gateway_frame_length > capacity;
+        gateway_frame_length = 0;
+    } else if (serial_backend != EPOLL_BACKEND) {
+        last_read_ns = monotonicNs();
+        stored = qMax<qint64>(0, serial_conn.read(out, capacity));
+        // readyRead only comes again for new bytes, do not leave any behind
+        while (serial_conn.bytesAvailable() > 0 && serial_conn.read(scratch, sizeof(scratch)) > 0) {
+            discarded = true;
+        }
+    } else {
+#ifdef Q_OS_LINUX
+        // edge triggered, read until the kernel has nothing left
+        while (true) {
+            char *target = stored < capacity ? out + stored : scratch;
+            const int room = stored < capacity ? capacity - stored : (int)sizeof(scratch);
+            ssize_t count = ::read(port_fd, target, room);
+            if (count > 0) {
+                if (target == scratch) {
+                    discarded = true;
+                } else {
+                    stored += count;
+                }
+            } else if (count == -1 && errno == EINTR) {
+                continue;
+            } else {
+                epoll_read_failed = count == -1 && errno != EAGAIN;
+                break;
+            }
+        }
+#endif
+    }
+
+    if (discarded) {
+        receive_overflows++;
+    }
+    return stored;
+}
+
+int SerialComm::receiveSerialData() {
+    const int count = readSerialData(receive_buffer + receive_length, receive_capacity - receive_length);
+    receive_length += count;
+    return count;
+}
+
+void SerialComm::clearReceiveBuffer() {
+    receive_length = 0;
+}
+
+void SerialComm::emitRawData() {
+    // the QString is only worth building for someone listening, usually the GUI
+    static const QMetaMethod raw_data_signal = QMetaMethod::fromSignal(&SerialComm::rawDataSignal);
+    if (isSignalConnected(raw_data_signal)) {
+        // written in place, a direct connection hands it on without a copy
+        raw_data_text.resize(receive_length);
+        QChar *text = raw_data_text.data();
+        for (int i=0; i<receive_length; i++) {
+            text[i] = QLatin1Char(receive_buffer[i]);
+        }
+        emit rawDataSignal(raw_data_text);
+    }
+}
+
+void SerialComm::clearSerialData() {
+    if (serial_backend == TCP_BACKEND || serial_backend == BUS_BACKEND) {
+        // a reply still on its way is recognised as stale by its tag
+        gateway_frame_length = 0;
+        return;
+    }
+    if (serial_backend != EPOLL_BACKEND) {
+        serial_conn.clear();
+        return;
+    }
+#ifdef Q_OS_LINUX
+    if (port_fd != -1) {
+        tcflush(port_fd, TCIOFLUSH);
+    }
+#endif
+}
+
+int SerialComm::serialHandle() {
+    if (serial_backend == EPOLL_BACKEND) {
+        return port_fd;
+    } else if (serial_backend == TCP_BACKEND || serial_backend == BUS_BACKEND) {
+        return -1;
+    }
+    return serial_conn.handle();
+}
+
 //Private
+bool SerialComm::openEpollPort() {
+#ifdef Q_OS_LINUX
+    QString name = serial_conn.portName();
+    QString path = name.startsWith('/') ? name : "/dev/" + name;
+
+    int fd = ::open(path.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1) {
+        QSerialPort::SerialPortError error = QSerialPort::OpenError;
+        if (errno == ENOENT) {
+            error = QSerialPort::DeviceNotFoundError;
+        } else if (errno == EACCES || errno == EBUSY) {
+            error = QSerialPort::PermissionError;
+        }
+        sendError(error, QString("%1: %2").arg(path, strerror(errno)));
+        return false;
+    }
+
+    // same line settings QSerialPort would apply, taken from serial_conn
+    struct termios tio;
+    speed_t speed = toSpeed(serial_conn.baudRate());
+    if (tcgetattr(fd, &tio) == -1 || speed == B0) {
+        ::close(fd);
+        sendError(QSerialPort::UnsupportedOperationError, "Unsupported line settings");
+        return false;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+
+    tio.c_cflag &= ~CSIZE;
+    switch (serial_conn.dataBits()) {
+        case QSerialPort::Data5: tio.c_cflag |= CS5; break;
+        case QSerialPort::Data6: tio.c_cflag |= CS6; break;
+        case QSerialPort::Data7: tio.c_cflag |= CS7; break;
+        default: tio.c_cflag |= CS8; break;
+    }
+
+    tio.c_cflag &= ~(PARENB | PARODD | CMSPAR);
+    switch (serial_conn.parity()) {
+        case QSerialPort::EvenParity: tio.c_cflag |= PARENB; break;
+        case QSerialPort::OddParity: tio.c_cflag |= PARENB | PARODD; break;
+        case QSerialPort::MarkParity: tio.c_cflag |= PARENB | CMSPAR | PARODD; break;
+        case QSerialPort::SpaceParity: tio.c_cflag |= PARENB | CMSPAR; break;
+        default: break;
+    }
+
+    if (serial_conn.stopBits() == QSerialPort::TwoStop) {
+        tio.c_cflag |= CSTOPB;
+    } else {
+        tio.c_cflag &= ~CSTOPB;
+    }
+
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (serial_conn.flowControl() == QSerialPort::HardwareControl) {
+        tio.c_cflag |= CRTSCTS;
+    } else if (serial_conn.flowControl() == QSerialPort::SoftwareControl) {
+        tio.c_iflag |= IXON | IXOFF;
+    }
+
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) == -1) {
+        ::close(fd);
+        sendError(QSerialPort::UnsupportedOperationError, strerror(errno));
+        return false;
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    if (!EpollSerialLoop::instance()->addLink(fd, [this](quint32 events) { epollEvents(events); })) {
+        ::close(fd);
+        sendError(QSerialPort::OpenError, "Could not watch port");
+        return false;
+    }
+    port_fd = fd;
+    return true;
+#else
+    sendError(QSerialPort::UnsupportedOperationError, "epoll backend is only available on Linux");
+    return false;
+#endif
+}
+
+void SerialComm::closeEpollPort() {
+#ifdef Q_OS_LINUX
+    if (port_fd != -1) {
+        EpollSerialLoop::instance()->removeLink(port_fd);
+        ::close(port_fd);
+        port_fd = -1;
+    }
+#endif
+}
+
+void SerialComm::epollEvents(quint32 events) {
+#ifdef Q_OS_LINUX
+    // the read itself happens in readSerialData, called from serialConnReceiveMessage
+    last_read_ns = monotonicNs();
+    epoll_read_failed = false;
+    if (events & EPOLLIN) {
+        serialConnReceiveMessage();
+    }
+    if (epoll_read_failed) {
+        events |= EPOLLERR;
+    }
+    if (port_fd != -1 && (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))) {
+        // reported while still open, so listeners close the link as for QSerialPort
+        sendError(QSerialPort::ResourceError, "Device disconnected");
+        // a hung up fd keeps signalling, it must not stay registered either way
+        closeEpollPort();
+    }
+#else
+    Q_UNUSED(events);
+#endif
+}
+
+bool SerialComm::openGatewayConn() {
+    gateway_buffered = 0;
+    gateway_frame_length = 0;
+    // open straight away so requests can queue, the GUI thread must not wait on the connect;
+    // a failed connect is reported by gatewayError and closes the link again
+    gateway_open = true;
+    gateway_connecting = true;
+    gateway_conn.connectToHost(gateway_host, gateway_port);
+    return true;
+}
+
+void SerialComm::gatewayConnected() {
+    gateway_connecting = false;
+    // frames are a dozen bytes, never hold them back for coalescing
+    gateway_conn.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    sendMessage(); // whatever came up while connecting
+}
+
+void SerialComm::gatewayReadyRead() {
+    last_read_ns = monotonicNs();
+    while (gateway_open) {
+        const qint64 count = gateway_conn.read(gateway_buffer + gateway_buffered,
+                                               sizeof(gateway_buffer) - gateway_buffered);
+        if (count <= 0) {
+            break;
+        }
+        gateway_buffered += count;
+
+        int offset = 0;
+        quint32 tag;
+        quint8 status;
+        while (GatewayProtocol::decodeResponse(gateway_buffer, gateway_buffered, offset, tag, status,
+                                               gateway_frame, gateway_frame_length)) {
+            if (tag != gateway_tag || !request_active) {
+                continue; // answer to a request that already timed out
+            }
+            if (status != QSerialPort::NoError) {
+                sendError((QSerialPort::SerialPortError)status, "Gateway reported an error");
+            } else {
+                serialConnReceiveMessage();
+            }
+            if (!gateway_open) {
+                return; // closed from a callback
+            }
+        }
+        gateway_frame_length = 0;
+        gateway_buffered -= offset;
+        memmove(gateway_buffer, gateway_buffer + offset, gateway_buffered);
+    }
+}
+
+void SerialComm::gatewayError(QAbstractSocket::SocketError error) {
+    Q_UNUSED(error);
+    if (gateway_connecting) {
+        // like a port that would not open, whatever was queued meanwhile fails with NotOpenError
+        gateway_connecting = false;
+        sendError(QSerialPort::OpenError, QString("Gateway %1:%2: %3")
+                  .arg(gateway_host).arg(gateway_port).arg(gateway_conn.errorString()));
+        closeSerialPort();
+    } else if (gateway_open) {
+        // later errors are reported like an unplugged adapter
+        sendError(QSerialPort::ResourceError, "Gateway: " + gateway_conn.errorString());
+    }
+}
+
+void SerialComm::startReplyTimeout() {
+    if (serial_backend == BUS_BACKEND && current_request.times.sent_ns == 0) {
+        // still waiting for the line, which is not the controller's fault
+        bus_timeout_ms = replyTimeout();
+        return;
+    }
+    timeout_timer.start(replyTimeout());
+}
+
+void SerialComm::stopReplyTimeout() {
+    timeout_timer.stop();
+    bus_timeout_ms = 0;
+}
+
+int SerialComm::replyTimeout() const {
+    // through a gateway the reply also waits out the gateway's queue, see GatewayProtocol
+    return serial_backend == TCP_BACKEND ? GatewayProtocol::client_timeout_ms : 1000;
+}
+
+void SerialComm::relayFrame(const char *frame, int length, qint64 read_ns) {
+    last_read_ns = read_ns;
+    gateway_frame = frame;
+    gateway_frame_length = length;
+    serialConnReceiveMessage();
+    gateway_frame_length = 0;
+}
+
 void SerialComm::collectErrorData(QSerialPort::SerialPortError error) {
     //clearError causes another NoError signal to be sent
     if (error != QSerialPort::NoError) {
@@ -64,9 +1001,24 @@ void SerialComm::collectErrorData(QSerialPort::SerialPortError error) {
     }
 }
 
+void SerialComm::collectBytesWritten() {
+    if (request_active) {
+        current_request.times.sent_ns = monotonicNs();
+    }
+}
+
 void SerialComm::timeout() {
-    if (temp_data != "") {
-        qDebug() << "Return data:" << temp_data;
+    if (receive_length > 0) {
+        qDebug() << "Return data:" << QByteArray(receive_buffer, receive_length);
         sendError(QSerialPort::TimeoutError, "Timeout partial data");
+    } else if (request_active) {
+        if (serial_backend == TCP_BACKEND && ++current_request.attempts >= GatewayProtocol::client_max_attempts) {
+            // the gateway answers within its deadline, a retry would only duplicate the request
+            sendError(QSerialPort::TimeoutError, "Gateway did not answer");
+            return;
+        }
+        // No reply at all, put it back so more urgent requests can go first on the retry
+        command_queue[current_request.priority].prepend(std::move(current_request));
+        request_active = false;
     }
 }
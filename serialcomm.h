@@ -2,45 +2,220 @@
 #define SERIALCOMM_H
 
 #include <QObject>
-#include <QQueue>
-#include <QTimer>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QLoggingCategory>
 #include <QSerialPort>
+#include <QTcpSocket>
 #include <QDebug>
+#include <functional>
 #include "settingsdialog.h"
+#include "ringqueue.h"
+#include "timerwheel.h"
+
+// request and reply frames, off by default: QT_LOGGING_RULES="ovencomm.frames.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(serialFrames)
+
+class SerialBus;
 
 class SerialComm : public QObject
 {
     Q_OBJECT
 public:
     //enum class commands{}; Implemented in child class
+    // marks commands that were queued together and should go out back-to-back
+    enum groups { NO_GROUP=0, GROUP_MEMBER=1, GROUP_END=2 };
+    // scheduling levels, lower value is sent first
+    enum priorities { SAFETY=0, SET=1, INTERACTIVE=2, POLLING=3, PRIORITY_COUNT=4 };
+    // what happens when a request arrives at a full queue
+    enum overflow_policies { REJECT_NEW=0, DROP_OLDEST=1 };
+    // how the tty is driven, EPOLL_BACKEND shares one epoll set per thread (Linux only),
+    // TCP_BACKEND talks to an OvenGateway instead, see isGatewayName(), BUS_BACKEND is one
+    // addressed controller on an RS-485 bus shared with others, selected by SerialBus::addLink
+    enum backends { QT_BACKEND=0, EPOLL_BACKEND=1, TCP_BACKEND=2, BUS_BACKEND=3 };
+
+    // CLOCK_MONOTONIC nanoseconds, see monotonicNs(), 0 if the stage was not reached
+    struct FrameTimes {
+        qint64 enqueued_ns = 0;   // request queued
+        qint64 dequeued_ns = 0;   // taken off the queue to be sent, the last attempt if it was retried
+        qint64 sent_ns = 0;       // request frame handed to the driver
+        qint64 first_byte_ns = 0; // first reply byte read
+        qint64 last_byte_ns = 0;  // reply frame complete
+        qint64 decoded_ns = 0;    // reply checked and parsed, before returnData
+        quint32 trace_id = 0;     // LatencyTrace id, 0 when tracing is off
+    };
+
+    // outcome of one request, for callers that want it directly rather than through returnData
+    struct Reply {
+        int command = 0;
+        bool ok = false;
+        int value = 0;
+        QSerialPort::SerialPortError error = QSerialPort::NoError;
+        FrameTimes times;
+    };
+    typedef std::function<void(const SerialComm::Reply &reply)> ReplyCallback;
+
+    struct Request {
+        int command = 0;
+        int value = 0; // data field as sent, e.g. temp x 100
+        int group = NO_GROUP;
+        int priority = INTERACTIVE;
+        int attempts = 0; // timed out sends, TCP_BACKEND gives up after a few
+        FrameTimes times;
+        ReplyCallback callback; // called exactly once, on reply, error, drop or close
+    };
+
+    // Request slots are allocated with the queue limits (one extra for a request put
+    // back after a timeout or preemption), the reply is assembled in a fixed buffer and
+    // rawDataSignal reuses one string, so the link itself does no heap allocation per
+    // command. What it does not cover: a callback too large for std::function's small
+    // buffer is allocated by the caller, and a queued receiver of rawDataSignal that
+    // still holds the previous string makes the next one a copy. The counters show
+    // when the rest does not hold.
+    struct PoolStats {
+        int request_slots = 0;       // preallocated over all priorities
+        int requests_queued = 0;
+        int request_pool_grows = 0;  // a queue ran out of slots and was reallocated
+        int receive_capacity = 0;
+        int receive_overflows = 0;   // bytes arrived that did not fit, they are discarded
+        qint64 heap_allocations = -1; // whole process, -1 unless built with CONFIG+=count_allocations
+        qint64 heap_frees = -1;
+    };
+    static const int receive_capacity = 64;
+
+    // driver settings the low latency tuning changes, the defaults are the driver's
+    struct LatencyTuning {
+        bool async_low_latency = false;
+        int vmin = 0;
+        int vtime = 0;
+        QByteArray latency_timer = "16"; // ms, FTDI adapters only
+    };
+
     explicit SerialComm(QObject *parent = nullptr);
+    ~SerialComm();
     void openSerialPort();
-    void closeSerialPort();
+    virtual void closeSerialPort();
     bool isOpen();
     void updateSerialInfo(const SettingsDialog::Settings &settings);
     void startSendMessageTimer();
+    void setQueueLimit(int priority, int limit, int overflow_policy);
+    bool hasPendingRequest(int command) const;
+    void setSendInterval(int interval_ms);
+    qint64 lastRoundTripUs() const; // write to complete reply of the last request, -1 if none yet
+    static qint64 monotonicNs();
+    bool setLowLatencyTuning(bool enable); // false puts back what was there before true
+    bool isLowLatency() const;
+    // the adapter's settings as they are now and setting them directly, false for any
+    // part that could not be read or set
+    bool readLatencyTuning(LatencyTuning &tuning);
+    bool applyLatencyTuning(const LatencyTuning &tuning);
+    void setBackend(int backend); // takes effect on the next openSerialPort
+    int backend() const;
+    QString portName() const; // as set by updateSerialInfo
+    // port names of the form tcp://host:port/oven select TCP_BACKEND in updateSerialInfo
+    static bool isGatewayName(const QString &name);
+    // rs485://port/address names a controller on a SerialBus, see SerialBus::parseBusName
+    static bool isBusName(const QString &name);
+    SerialBus *sharedBus() const; // the bus this link is on, nullptr unless added to one
+    void sendPending(); // next queued request goes out now if the line is idle
+    PoolStats poolStats() const;
 
 protected:
     virtual void serialConnSendMessage() = 0;
     virtual void sendError(QSerialPort::SerialPortError error, const QString &error_message) = 0;
 
+    bool enqueueRequest(int command, int value, int priority,
+                        const ReplyCallback &callback = ReplyCallback());
+    // last writer wins, queued requests for the same command are superseded
+    bool enqueueLatest(int command, int value, int priority,
+                       const ReplyCallback &callback = ReplyCallback());
+    bool enqueueGroup(const QList<int> &commands, int priority);
+    bool takeNextRequest();
+    void finishCurrentRequest();
+    bool makeRoom(int command, int priority, int count); // for count more requests
+    void dropGroup(int priority);
+    void completeRequest(Request &request, bool ok, int value,
+                         QSerialPort::SerialPortError error = QSerialPort::NoError);
+    void failRequest(const ReplyCallback &callback, int command, QSerialPort::SerialPortError error);
+
+    qint64 writeSerialData(const QByteArray &data);
+    int replyTimeout() const; // ms to wait for the reply to a frame just written
+    // after a write: starts timeout_timer, on BUS_BACKEND once the bus has put the frame on the line
+    void startReplyTimeout();
+    void stopReplyTimeout();
+    int readSerialData(char *out, int capacity); // whatever does not fit is discarded
+    int receiveSerialData(); // appends to receive_buffer, returns the byte count added
+    void clearReceiveBuffer();
+    void emitRawData();
+    void clearSerialData();
+    int serialHandle();
+
     QSerialPort serial_conn;
-    QString temp_data = "";
-    QQueue<int> command_queue;
-    QQueue<QString> data_queue;
-    QTimer timeout_timer;
-    QTimer send_message_timer;
+    char receive_buffer[receive_capacity];
+    int receive_length = 0; // reply bytes so far
+    int receive_overflows = 0;
+    QString raw_data_text; // rawDataSignal's argument, reused while no receiver keeps it
+    RingQueue<Request> command_queue[PRIORITY_COUNT];
+    int queue_limit[PRIORITY_COUNT];
+    int queue_overflow_policy[PRIORITY_COUNT];
+    Request current_request;
+    bool request_active = false;
+    int group_priority = -1; // level of a partly sent group, -1 if none
+    WheelTimer timeout_timer;
+    WheelTimer send_message_timer;
+    qint64 last_round_trip_us = -1;
+    qint64 last_read_ns = 0; // when the bytes returned by readSerialData arrived
+    int trace_link; // thread id of this link in LatencyTrace exports
+    bool low_latency = false;
+    bool low_latency_applied = false;
+    // driver settings from before the tuning, put back by setLowLatencyTuning(false)
+    bool tuning_saved = false;
+    LatencyTuning saved_tuning;
+    int serial_backend = QT_BACKEND;
+    int port_fd = -1; // EPOLL_BACKEND only
+    bool epoll_read_failed = false;
+    QTcpSocket gateway_conn; // TCP_BACKEND only
+    bool gateway_open = false;
+    bool gateway_connecting = false; // requests wait in the queue until connected
+    QString gateway_host;
+    quint16 gateway_port = 0;
+    quint8 gateway_oven = 0;
+    quint32 gateway_tag = 0; // of the request in flight, older replies are stale
+    char gateway_buffer[512]; // received envelopes not yet complete, one is at most 261 bytes
+    int gateway_buffered = 0;
+    const char *gateway_frame = nullptr; // reply frame for readSerialData, also BUS_BACKEND's
+    int gateway_frame_length = 0;
+    QPointer<SerialBus> bus; // BUS_BACKEND only
+    bool bus_open = false;
+    quint32 bus_tag = 0; // of the frame handed to the bus, a reply for an older one is stale
+    int bus_timeout_ms = 0; // for the bus to start at transmit, 0 when the frame wants none
 
 signals:
     void rawDataSignal(QString data);
-    void returnData(QString data, int command_sent);
+    void returnData(int value, int command_sent, SerialComm::FrameTimes times);
     void errorSignal(QSerialPort::SerialPortError error, QString error_string, int command_sent);
+    void requestDropped(int command_sent, int priority);
+
+private:
+    friend class SerialBus;
+
+    bool openEpollPort();
+    void closeEpollPort();
+    void epollEvents(quint32 events);
+    bool openGatewayConn();
+    void gatewayConnected();
+    void gatewayReadyRead();
+    void gatewayError(QAbstractSocket::SocketError error);
+    void relayFrame(const char *frame, int length, qint64 read_ns); // a reply routed by SerialBus
 
 private slots:
     virtual void serialConnReceiveMessage() = 0;
     virtual void sendMessage() = 0;
     void collectErrorData(QSerialPort::SerialPortError error);
     void timeout();
+    void collectBytesWritten();
 };
 
+Q_DECLARE_METATYPE(SerialComm::FrameTimes)
+
 #endif // SERIALCOMM_H
@@ -51,9 +51,14 @@
 
 #include "settingsdialog.h"
 #include "ui_settingsdialog.h"
+#include "linkprobe.h"
+#include "serialcomm.h"
+#include "portenumerator.h"
 
+#include <QFileInfo>
 #include <QIntValidator>
 #include <QLineEdit>
+#include <QMessageBox>
 #include <QSerialPortInfo>
 
 static const char blankString[] = QT_TRANSLATE_NOOP("SettingsDialog", "N/A");
@@ -61,7 +66,8 @@ static const char blankString[] = QT_TRANSLATE_NOOP("SettingsDialog", "N/A");
 SettingsDialog::SettingsDialog(QWidget *parent) :
     QDialog(parent),
     m_ui(new Ui::SettingsDialog),
-    m_intValidator(new QIntValidator(0, 4000000, this))
+    m_intValidator(new QIntValidator(0, 4000000, this)),
+    m_probe(new LinkProbe(this))
 {
     m_ui->setupUi(this);
 
@@ -75,6 +81,18 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
             this, &SettingsDialog::checkCustomBaudRatePolicy);
     connect(m_ui->serialPortInfoListBox, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &SettingsDialog::checkCustomDevicePathPolicy);
+    connect(m_ui->probeButton, &QPushButton::clicked,
+            this, &SettingsDialog::probe);
+    connect(m_probe, &LinkProbe::probeFinished,
+            this, [this](QList<LinkProbe::Result> results, int best_index) {
+        if (m_comparingLatency && results.count() == 2)
+            latencyCompared(results.at(0).mean_round_trip_ms, results.at(1).mean_round_trip_ms,
+                            results.at(1).errors == 0);
+        else
+            probeFinished(best_index == -1 ? 0 : results.at(best_index).baud_rate);
+    });
+    connect(PortEnumerator::instance(), &PortEnumerator::portsChanged,
+            this, &SettingsDialog::refreshPorts);
 
     fillPortsParameters();
     fillPortsInfo();
@@ -106,10 +124,41 @@ void SettingsDialog::showPortInfo(int idx)
     m_ui->pidLabel->setText(tr("Product Identifier: %1").arg(list.count() > 6 ? list.at(6) : tr(blankString)));
 }
 
+void SettingsDialog::setSettings(const Settings &settings)
+{
+    const int portIndex = m_ui->serialPortInfoListBox->findText(settings.name);
+    if (portIndex != -1) {
+        m_ui->serialPortInfoListBox->setCurrentIndex(portIndex);
+    } else {
+        // not enumerated yet, fillPortsInfo switches to the listed entry once it shows up
+        m_ui->serialPortInfoListBox->setCurrentIndex(m_ui->serialPortInfoListBox->count() - 1);
+        m_ui->serialPortInfoListBox->setEditText(settings.name);
+    }
+
+    const int baudIndex = m_ui->baudRateBox->findData(settings.baudRate);
+    if (baudIndex != -1) {
+        m_ui->baudRateBox->setCurrentIndex(baudIndex);
+    } else {
+        m_ui->baudRateBox->setCurrentIndex(4);
+        m_ui->baudRateBox->setEditText(QString::number(settings.baudRate));
+    }
+
+    m_ui->dataBitsBox->setCurrentIndex(qMax(0, m_ui->dataBitsBox->findData(settings.dataBits)));
+    m_ui->parityBox->setCurrentIndex(qMax(0, m_ui->parityBox->findData(settings.parity)));
+    m_ui->stopBitsBox->setCurrentIndex(qMax(0, m_ui->stopBitsBox->findData(settings.stopBits)));
+    m_ui->flowControlBox->setCurrentIndex(qMax(0, m_ui->flowControlBox->findData(settings.flowControl)));
+    m_ui->localEchoCheckBox->setChecked(settings.localEchoEnabled);
+    m_ui->lowLatencyCheckBox->setChecked(settings.lowLatency);
+    m_ui->autoConnectCheckBox->setChecked(settings.autoConnect);
+
+    updateSettings();
+}
+
 void SettingsDialog::apply()
 {
     updateSettings();
     hide();
+    emit settingsApplied();
 }
 
 void SettingsDialog::checkCustomBaudRatePolicy(int idx)
@@ -131,6 +180,70 @@ void SettingsDialog::checkCustomDevicePathPolicy(int idx)
         m_ui->serialPortInfoListBox->clearEditText();
 }
 
+void SettingsDialog::setActiveLink(SerialComm *link)
+{
+    m_activeLink = link;
+}
+
+void SettingsDialog::probe()
+{
+    updateSettings();
+
+    if (m_activeLink && m_activeLink->isOpen()
+            && QFileInfo(m_activeLink->portName()).fileName() == QFileInfo(m_currentSettings.name).fileName()) {
+        QMessageBox::warning(this, tr("Probe"), tr("%1 is in use, disconnect before probing it.")
+                             .arg(m_currentSettings.name));
+        return;
+    }
+
+    QList<qint32> baudRates;
+    for (int i = 0; i < m_ui->baudRateBox->count(); ++i) {
+        if (m_ui->baudRateBox->itemData(i).isValid())
+            baudRates << m_ui->baudRateBox->itemData(i).toInt();
+    }
+
+    m_ui->probeButton->setEnabled(false);
+    m_ui->applyButton->setEnabled(false);
+    m_comparingLatency = false;
+    m_probe->start(m_currentSettings, baudRates);
+}
+
+void SettingsDialog::probeFinished(qint32 best_rate)
+{
+    if (best_rate == 0) {
+        m_ui->probeButton->setEnabled(true);
+        m_ui->applyButton->setEnabled(true);
+        QMessageBox::warning(this, tr("Probe"), tr("No baud rate gave error free replies."));
+        return;
+    }
+
+    m_ui->baudRateBox->setCurrentIndex(m_ui->baudRateBox->findData(best_rate));
+    updateSettings();
+
+    if (m_currentSettings.lowLatency) {
+        m_comparingLatency = true;
+        m_probe->compareLowLatency(m_currentSettings);
+        return;
+    }
+    m_ui->probeButton->setEnabled(true);
+    m_ui->applyButton->setEnabled(true);
+}
+
+void SettingsDialog::latencyCompared(double before_ms, double after_ms, bool reliable)
+{
+    m_comparingLatency = false;
+    m_ui->probeButton->setEnabled(true);
+    m_ui->applyButton->setEnabled(true);
+
+    if (!reliable) {
+        QMessageBox::warning(this, tr("Probe"), tr("Low latency mode did not give error free replies."));
+        return;
+    }
+    QMessageBox::information(this, tr("Probe"),
+                             tr("Round trip %1 ms untuned, %2 ms with low latency.")
+                             .arg(before_ms, 0, 'f', 2).arg(after_ms, 0, 'f', 2));
+}
+
 void SettingsDialog::fillPortsParameters()
 {
     m_ui->baudRateBox->addItem(QStringLiteral("9600"), QSerialPort::Baud9600);
@@ -162,13 +275,26 @@ void SettingsDialog::fillPortsParameters()
     m_ui->flowControlBox->addItem(tr("XON/XOFF"), QSerialPort::SoftwareControl);
 }
 
+void SettingsDialog::refreshPorts()
+{
+    fillPortsInfo();
+    // until the dialog is applied the settings follow the first listed port
+    if (!isVisible())
+        updateSettings();
+}
+
 void SettingsDialog::fillPortsInfo()
 {
+    // enumeration runs in the background, this only lists what it has cached so far
+    const QString selected = m_ui->serialPortInfoListBox->currentText();
+    const bool wasCustom = !m_ui->serialPortInfoListBox->currentData().isValid();
+
+    m_ui->serialPortInfoListBox->blockSignals(true);
     m_ui->serialPortInfoListBox->clear();
     QString description;
     QString manufacturer;
     QString serialNumber;
-    const auto infos = QSerialPortInfo::availablePorts();
+    const auto infos = PortEnumerator::instance()->ports();
     for (const QSerialPortInfo &info : infos) {
         QStringList list;
         description = info.description();
@@ -186,6 +312,23 @@ void SettingsDialog::fillPortsInfo()
     }
 
     m_ui->serialPortInfoListBox->addItem(tr("Custom"));
+    m_ui->serialPortInfoListBox->blockSignals(false);
+
+    // keep the user's choice across hot-plug refreshes
+    const int index = m_ui->serialPortInfoListBox->findText(selected);
+    if (!selected.isEmpty() && index != -1) {
+        m_ui->serialPortInfoListBox->setCurrentIndex(index);
+        showPortInfo(index);
+        checkCustomDevicePathPolicy(index);
+    } else if (!selected.isEmpty() && wasCustom) {
+        m_ui->serialPortInfoListBox->setCurrentIndex(m_ui->serialPortInfoListBox->count() - 1);
+        checkCustomDevicePathPolicy(m_ui->serialPortInfoListBox->count() - 1);
+        m_ui->serialPortInfoListBox->setEditText(selected);
+    } else {
+        m_ui->serialPortInfoListBox->setCurrentIndex(0);
+        showPortInfo(0);
+        checkCustomDevicePathPolicy(0);
+    }
 }
 
 void SettingsDialog::updateSettings()
@@ -217,4 +360,6 @@ void SettingsDialog::updateSettings()
     m_currentSettings.stringFlowControl = m_ui->flowControlBox->currentText();
 
     m_currentSettings.localEchoEnabled = m_ui->localEchoCheckBox->isChecked();
+    m_currentSettings.lowLatency = m_ui->lowLatencyCheckBox->isChecked();
+    m_currentSettings.autoConnect = m_ui->autoConnectCheckBox->isChecked();
 }
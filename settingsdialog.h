@@ -54,6 +54,7 @@
 
 #include <QDialog>
 #include <QSerialPort>
+#include <QList>
 
 QT_BEGIN_NAMESPACE
 
@@ -65,6 +66,9 @@ class QIntValidator;
 
 QT_END_NAMESPACE
 
+class LinkProbe;
+class SerialComm;
+
 class SettingsDialog : public QDialog
 {
     Q_OBJECT
@@ -83,18 +87,30 @@ public:
         QSerialPort::FlowControl flowControl;
         QString stringFlowControl;
         bool localEchoEnabled;
+        bool lowLatency;
+        bool autoConnect;
     };
 
     explicit SettingsDialog(QWidget *parent = nullptr);
     ~SettingsDialog();
 
     Settings settings() const;
+    void setSettings(const Settings &settings);
+    // the probe will not touch the port this link has open
+    void setActiveLink(SerialComm *link);
+
+signals:
+    void settingsApplied();
 
 private slots:
     void showPortInfo(int idx);
     void apply();
     void checkCustomBaudRatePolicy(int idx);
     void checkCustomDevicePathPolicy(int idx);
+    void probe();
+    void probeFinished(qint32 best_rate); // 0 if none worked
+    void latencyCompared(double before_ms, double after_ms, bool reliable);
+    void refreshPorts();
 
 private:
     void fillPortsParameters();
@@ -105,6 +121,9 @@ private:
     Ui::SettingsDialog *m_ui = nullptr;
     Settings m_currentSettings;
     QIntValidator *m_intValidator = nullptr;
+    LinkProbe *m_probe = nullptr;
+    SerialComm *m_activeLink = nullptr;
+    bool m_comparingLatency = false;
 };
 
 #endif // SETTINGSDIALOG_H
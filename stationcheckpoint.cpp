@@ -0,0 +1,79 @@
+#include "stationcheckpoint.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+QString StationCheckpoint::defaultFileName() {
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    return dir + "/station.ckpt";
+}
+
+bool StationCheckpoint::save(const QString &file_name, const QList<OvenState> &ovens) {
+    QSaveFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_9);
+    out << magic << version << QDateTime::currentMSecsSinceEpoch() << (quint32)ovens.size();
+    for (const OvenState &state : ovens) {
+        out << state.oven_id << state.set_temp_valid << state.set_temp
+            << state.power_valid << state.power_on << (qint32)state.poll_interval_ms;
+        out << (quint32)state.profile.size();
+        for (const ProfileEngine::Point &point : state.profile) {
+            out << point.time_ms << point.temp;
+        }
+        out << state.profile_running << state.profile_elapsed_ms << state.log_file << state.log_offset;
+    }
+
+    if (out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool StationCheckpoint::load(const QString &file_name, QList<OvenState> &ovens, qint64 &saved_ms) {
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_9);
+    quint32 file_magic = 0;
+    quint16 file_version = 0;
+    quint32 count = 0;
+    in >> file_magic >> file_version >> saved_ms >> count;
+    if (file_magic != magic || file_version != version) {
+        return false;
+    }
+
+    ovens.clear();
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; i++) {
+        OvenState state;
+        qint32 poll_interval = 0;
+        quint32 points = 0;
+        in >> state.oven_id >> state.set_temp_valid >> state.set_temp
+           >> state.power_valid >> state.power_on >> poll_interval >> points;
+        state.poll_interval_ms = poll_interval;
+        for (quint32 j=0; j<points && in.status() == QDataStream::Ok; j++) {
+            ProfileEngine::Point point;
+            in >> point.time_ms >> point.temp;
+            state.profile.append(point);
+        }
+        in >> state.profile_running >> state.profile_elapsed_ms >> state.log_file >> state.log_offset;
+        ovens.append(state);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        ovens.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef STATIONCHECKPOINT_H
+#define STATIONCHECKPOINT_H
+
+#include <QList>
+#include <QString>
+#include <QVector>
+#include "profileengine.h"
+
+// Small binary snapshot of what OvenStation needs to pick up where it left off.
+// Written through QSaveFile so a crash mid write leaves the previous one intact.
+class StationCheckpoint
+{
+public:
+    struct OvenState {
+        quint16 oven_id = 0;
+        bool set_temp_valid = false;
+        qint32 set_temp = 0; // last confirmed, temp x 100 as on the wire
+        bool power_valid = false;
+        bool power_on = false;
+        int poll_interval_ms = 0;
+        QVector<ProfileEngine::Point> profile;
+        bool profile_running = false;
+        qint64 profile_elapsed_ms = 0;
+        QString log_file;
+        qint64 log_offset = 0; // archive bytes on disk when the checkpoint was taken
+    };
+
+    static const quint32 magic = 0x4F56434B; // OVCK
+    static const quint16 version = 1;
+
+    static QString defaultFileName();
+    static bool save(const QString &file_name, const QList<OvenState> &ovens);
+    static bool load(const QString &file_name, QList<OvenState> &ovens, qint64 &saved_ms);
+};
+
+#endif // STATIONCHECKPOINT_H
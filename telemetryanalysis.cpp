@@ -0,0 +1,190 @@
+#include "telemetryanalysis.h"
+#include <QSet>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+
+void TelemetryAnalysis::OvenStats::merge(const OvenStats &other) {
+    runs += other.runs;
+    temp_samples += other.temp_samples;
+    replies += other.replies;
+    errors += other.errors;
+    in_tolerance_us += other.in_tolerance_us;
+    tracked_us += other.tracked_us;
+    setpoint_changes += other.setpoint_changes;
+    settled += other.settled;
+    overshoot_sum += other.overshoot_sum;
+    overshoot_max = qMax(overshoot_max, other.overshoot_max);
+    settle_sum_us += other.settle_sum_us;
+    settle_max_us = qMax(settle_max_us, other.settle_max_us);
+}
+
+double TelemetryAnalysis::OvenStats::toleranceFraction() const {
+    return tracked_us > 0 ? (double)in_tolerance_us / tracked_us : 0.0;
+}
+
+double TelemetryAnalysis::OvenStats::errorRate() const {
+    qint64 total = replies + errors;
+    return total > 0 ? (double)errors / total : 0.0;
+}
+
+double TelemetryAnalysis::OvenStats::meanOvershoot() const {
+    return setpoint_changes > 0 ? overshoot_sum / setpoint_changes : 0.0;
+}
+
+double TelemetryAnalysis::OvenStats::meanSettleSeconds() const {
+    return settled > 0 ? settle_sum_us / 1e6 / settled : 0.0;
+}
+
+bool TelemetryAnalysis::analyzeFile(const QString &file_name, double tolerance, Result &result, QString &error) {
+    TelemetryArchiveReader reader;
+    if (!reader.open(file_name)) {
+        error = reader.errorString();
+        return false;
+    }
+
+    QSet<quint16> ovens;
+    for (const TelemetryArchive::BlockInfo &info : reader.blocks()) {
+        ovens.insert(info.oven);
+    }
+    for (quint16 oven : ovens) {
+        result[oven].merge(analyzeOven(reader, oven, tolerance));
+    }
+    return true;
+}
+
+void TelemetryAnalysis::merge(Result &into, const Result &from) {
+    for (auto it = from.constBegin(); it != from.constEnd(); ++it) {
+        into[it.key()].merge(it.value());
+    }
+}
+
+TelemetryAnalysis::OvenStats TelemetryAnalysis::analyzeOven(TelemetryArchiveReader &reader, quint16 oven, double tolerance) {
+    const qint64 all_from = std::numeric_limits<qint64>::min();
+    const qint64 all_to = std::numeric_limits<qint64>::max();
+
+    OvenStats stats;
+    stats.runs = 1;
+    for (const TelemetryArchive::BlockInfo &info : reader.blocks()) {
+        if (info.oven == oven) {
+            if (info.command == NONE) {
+                stats.errors += info.count;
+            } else {
+                stats.replies += info.count;
+            }
+        }
+    }
+
+    const QVector<TelemetryArchive::Sample> temps = reader.read(oven, GETTEMP, all_from, all_to);
+    // setpoint known from both the reads and the acknowledged writes
+    QVector<TelemetryArchive::Sample> setpoints = reader.read(oven, GETSETTEMP, all_from, all_to);
+    setpoints += reader.read(oven, SETTEMP, all_from, all_to);
+    std::stable_sort(setpoints.begin(), setpoints.end(),
+                     [](const TelemetryArchive::Sample &a, const TelemetryArchive::Sample &b) {
+        return a.time_us < b.time_us;
+    });
+    stats.temp_samples = temps.size();
+
+    // one segment per setpoint change, from the change to the next one
+    bool has_setpoint = false;
+    double setpoint = 0.0;
+    qint64 change_us = 0;
+    int direction = 1;
+    double peak = 0.0;
+    qint64 settled_at = -1;
+
+    auto finishSegment = [&]() {
+        if (!has_setpoint) {
+            return;
+        }
+        stats.overshoot_sum += peak;
+        stats.overshoot_max = qMax(stats.overshoot_max, peak);
+        if (settled_at >= 0) {
+            qint64 settle_us = settled_at - change_us;
+            stats.settled++;
+            stats.settle_sum_us += settle_us;
+            stats.settle_max_us = qMax(stats.settle_max_us, settle_us);
+        }
+    };
+
+    int next_setpoint = 0;
+    for (int i=0; i<temps.size(); i++) {
+        const qint64 time_us = temps[i].time_us;
+        const double temp = temps[i].value / 100.0;
+
+        while (next_setpoint < setpoints.size() && setpoints[next_setpoint].time_us <= time_us) {
+            const TelemetryArchive::Sample &change = setpoints[next_setpoint++];
+            double new_setpoint = change.value / 100.0;
+            if (has_setpoint && new_setpoint == setpoint) {
+                continue;
+            }
+            finishSegment();
+            has_setpoint = true;
+            setpoint = new_setpoint;
+            change_us = change.time_us;
+            direction = setpoint >= temp ? 1 : -1;
+            peak = 0.0;
+            settled_at = -1;
+            stats.setpoint_changes++;
+        }
+        if (!has_setpoint) {
+            continue;
+        }
+
+        // each sample stands for the time up to the next one
+        qint64 span_us = i + 1 < temps.size() ? temps[i + 1].time_us - time_us : 0;
+        bool in_tolerance = qAbs(temp - setpoint) <= tolerance;
+        stats.tracked_us += span_us;
+        if (in_tolerance) {
+            stats.in_tolerance_us += span_us;
+            if (settled_at < 0) {
+                settled_at = time_us;
+            }
+        } else {
+            settled_at = -1;
+        }
+
+        double excess = direction > 0 ? temp - setpoint : setpoint - temp;
+        peak = qMax(peak, excess);
+    }
+    finishSegment();
+
+    return stats;
+}
+
+QString TelemetryAnalysis::formatTable(const Result &result) {
+    QString text;
+    QTextStream out(&text);
+    out << qSetFieldWidth(6) << "oven" << qSetFieldWidth(8) << "runs" << qSetFieldWidth(12) << "samples"
+        << "in tol %" << "changes" << "settled" << "overshoot" << "max over"
+        << "settle s" << "max set s" << "errors" << "error %" << qSetFieldWidth(0) << "\n";
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(2);
+
+    for (auto it = result.constBegin(); it != result.constEnd(); ++it) {
+        const OvenStats &stats = it.value();
+        out << qSetFieldWidth(6) << it.key() << qSetFieldWidth(8) << stats.runs << qSetFieldWidth(12)
+            << stats.temp_samples << stats.toleranceFraction() * 100.0
+            << stats.setpoint_changes << stats.settled
+            << stats.meanOvershoot() << stats.overshoot_max
+            << stats.meanSettleSeconds() << stats.settle_max_us / 1e6
+            << stats.errors << stats.errorRate() * 100.0 << qSetFieldWidth(0) << "\n";
+    }
+    return text;
+}
+
+QString TelemetryAnalysis::formatCsv(const Result &result) {
+    QString text;
+    QTextStream out(&text);
+    out << "oven,runs,samples,in_tolerance,setpoint_changes,settled,mean_overshoot,max_overshoot,"
+           "mean_settle_s,max_settle_s,replies,errors,error_rate\n";
+    for (auto it = result.constBegin(); it != result.constEnd(); ++it) {
+        const OvenStats &stats = it.value();
+        out << it.key() << ',' << stats.runs << ',' << stats.temp_samples << ','
+            << stats.toleranceFraction() << ',' << stats.setpoint_changes << ',' << stats.settled << ','
+            << stats.meanOvershoot() << ',' << stats.overshoot_max << ','
+            << stats.meanSettleSeconds() << ',' << stats.settle_max_us / 1e6 << ','
+            << stats.replies << ',' << stats.errors << ',' << stats.errorRate() << '\n';
+    }
+    return text;
+}
@@ -0,0 +1,49 @@
+#ifndef TELEMETRYANALYSIS_H
+#define TELEMETRYANALYSIS_H
+
+#include <QMap>
+#include <QString>
+#include "telemetryarchive.h"
+
+// Per oven control quality over one or more recorded runs, see OvenAnalyze.pro
+class TelemetryAnalysis
+{
+public:
+    // same values as OvenComm::commands, kept here so the CLI does not need QtSerialPort
+    enum commands { NONE=0, GETTEMP=1, GETSETTEMP=30, SETTEMP=60 };
+
+    struct OvenStats {
+        int runs = 0;
+        qint64 temp_samples = 0;
+        qint64 replies = 0;
+        qint64 errors = 0;
+        qint64 in_tolerance_us = 0; // time with |temp - setpoint| <= tolerance
+        qint64 tracked_us = 0;      // time with a known setpoint
+        int setpoint_changes = 0;
+        int settled = 0;            // changes after which temp entered and stayed in tolerance
+        double overshoot_sum = 0.0;
+        double overshoot_max = 0.0;
+        qint64 settle_sum_us = 0;
+        qint64 settle_max_us = 0;
+
+        void merge(const OvenStats &other);
+        double toleranceFraction() const;
+        double errorRate() const;
+        double meanOvershoot() const;
+        double meanSettleSeconds() const;
+    };
+
+    typedef QMap<quint16, OvenStats> Result;
+
+    // analyzes one archive file, tolerance in degrees
+    static bool analyzeFile(const QString &file_name, double tolerance, Result &result, QString &error);
+    static void merge(Result &into, const Result &from);
+
+    static QString formatTable(const Result &result);
+    static QString formatCsv(const Result &result);
+
+private:
+    static OvenStats analyzeOven(TelemetryArchiveReader &reader, quint16 oven, double tolerance);
+};
+
+#endif // TELEMETRYANALYSIS_H
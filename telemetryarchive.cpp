@@ -0,0 +1,399 @@
+#include "telemetryarchive.h"
+#include <QDataStream>
+#include <QtEndian>
+
+namespace {
+const qint64 header_size = 4 + 2;
+const qint64 block_header_size = 4 + 2 + 1 + 4 + 8 + 8 + 4;
+const qint64 footer_size = 8 + 4;
+const qint64 index_entry_size = 2 + 1 + 4 + 8 + 8 + 8;
+
+inline quint64 zigzag(qint64 value) {
+    return ((quint64)value << 1) ^ (quint64)(value >> 63);
+}
+
+inline qint64 unzigzag(quint64 value) {
+    return (qint64)(value >> 1) ^ -(qint64)(value & 1);
+}
+
+void putVarint(QByteArray &out, quint64 value) {
+    while (value >= 0x80) {
+        out.append((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.append((char)value);
+}
+
+bool getVarint(const uchar *&pos, const uchar *end, quint64 &value) {
+    value = 0;
+    for (int shift=0; shift<64 && pos < end; shift += 7) {
+        uchar byte = *pos++;
+        value |= (quint64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+QByteArray TelemetryArchive::encodeBlock(const QVector<Sample> &samples) {
+    QByteArray raw;
+    raw.reserve(samples.size() * 3);
+
+    // time column, a steady poll rate makes nearly every delta-of-delta 0
+    qint64 previous_time = 0;
+    qint64 previous_delta = 0;
+    for (int i=0; i<samples.size(); i++) {
+        if (i == 0) {
+            putVarint(raw, zigzag(samples[i].time_us));
+        } else {
+            qint64 delta = samples[i].time_us - previous_time;
+            putVarint(raw, zigzag(delta - previous_delta));
+            previous_delta = delta;
+        }
+        previous_time = samples[i].time_us;
+    }
+
+    // value column, slowly changing readings give one byte deltas
+    qint32 previous_value = 0;
+    for (int i=0; i<samples.size(); i++) {
+        putVarint(raw, zigzag((qint64)samples[i].value - previous_value));
+        previous_value = samples[i].value;
+    }
+
+    return qCompress(raw);
+}
+
+bool TelemetryArchive::decodeBlock(const QByteArray &payload, quint32 count, QVector<Sample> &samples) {
+    const QByteArray raw = qUncompress(payload);
+    const uchar *pos = reinterpret_cast<const uchar*>(raw.constData());
+    const uchar *end = pos + raw.size();
+    // a sample is at least two one byte varints, a larger count is a corrupt header
+    if (count > (quint32)raw.size() / 2) {
+        return false;
+    }
+
+    const int first = samples.size();
+    samples.resize(first + count);
+    Sample *out = samples.data() + first;
+
+    quint64 encoded;
+    qint64 time = 0;
+    qint64 delta = 0;
+    for (quint32 i=0; i<count; i++) {
+        if (!getVarint(pos, end, encoded)) {
+            samples.resize(first);
+            return false;
+        }
+        if (i == 0) {
+            time = unzigzag(encoded);
+        } else {
+            delta += unzigzag(encoded);
+            time += delta;
+        }
+        out[i].time_us = time;
+    }
+
+    qint64 value = 0;
+    for (quint32 i=0; i<count; i++) {
+        if (!getVarint(pos, end, encoded)) {
+            samples.resize(first);
+            return false;
+        }
+        value += unzigzag(encoded);
+        out[i].value = (qint32)value;
+    }
+    return true;
+}
+
+
+TelemetryArchiveWriter::~TelemetryArchiveWriter() {
+    close();
+}
+
+bool TelemetryArchiveWriter::open(const QString &file_name) {
+    close();
+    file.setFileName(file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    columns.clear();
+    index.clear();
+
+    QDataStream out(&file);
+    out << TelemetryArchive::file_magic << TelemetryArchive::version;
+    return out.status() == QDataStream::Ok;
+}
+
+bool TelemetryArchiveWriter::openAppend(const QString &file_name) {
+    close();
+    if (!QFile::exists(file_name)) {
+        return open(file_name);
+    }
+
+    qint64 data_end = 0;
+    QVector<TelemetryArchive::BlockInfo> blocks;
+    {
+        TelemetryArchiveReader reader;
+        if (!reader.open(file_name)) {
+            file.setFileName(file_name);
+            return false;
+        }
+        blocks = reader.blocks();
+        data_end = reader.dataEnd();
+    }
+
+    // drops the old index and anything a crash left half written
+    file.setFileName(file_name);
+    if (!file.open(QIODevice::ReadWrite) || !file.resize(data_end) || !file.seek(data_end)) {
+        file.close();
+        return false;
+    }
+    columns.clear();
+    index = blocks;
+    return true;
+}
+
+void TelemetryArchiveWriter::close() {
+    if (!file.isOpen()) {
+        return;
+    }
+    flush();
+
+    qint64 index_offset = file.pos();
+    QDataStream out(&file);
+    out << TelemetryArchive::index_magic << (quint32)index.size();
+    for (const TelemetryArchive::BlockInfo &info : index) {
+        out << info.oven << info.command << info.count << info.first_us << info.last_us << info.offset;
+    }
+    out << index_offset << TelemetryArchive::footer_magic;
+    file.close();
+}
+
+bool TelemetryArchiveWriter::isOpen() const {
+    return file.isOpen();
+}
+
+QString TelemetryArchiveWriter::errorString() const {
+    return file.errorString();
+}
+
+QString TelemetryArchiveWriter::fileName() const {
+    return file.fileName();
+}
+
+qint64 TelemetryArchiveWriter::writtenSize() const {
+    return file.isOpen() ? file.pos() : 0;
+}
+
+void TelemetryArchiveWriter::append(quint16 oven, quint8 command, qint64 time_us, qint32 value) {
+    if (!file.isOpen()) {
+        return;
+    }
+    QVector<TelemetryArchive::Sample> &column = columns[((quint32)oven << 8) | command];
+    if (column.isEmpty()) {
+        column.reserve(TelemetryArchive::block_samples);
+    }
+    column.append({time_us, value});
+    if (column.size() >= TelemetryArchive::block_samples) {
+        writeBlock(oven, command, column);
+    }
+}
+
+void TelemetryArchiveWriter::flush() {
+    if (!file.isOpen()) {
+        return;
+    }
+    for (auto it = columns.begin(); it != columns.end(); ++it) {
+        writeBlock(it.key() >> 8, it.key() & 0xff, it.value());
+    }
+    file.flush();
+}
+
+void TelemetryArchiveWriter::writeBlock(quint16 oven, quint8 command, QVector<TelemetryArchive::Sample> &samples) {
+    if (samples.isEmpty()) {
+        return;
+    }
+
+    TelemetryArchive::BlockInfo info;
+    info.oven = oven;
+    info.command = command;
+    info.count = samples.size();
+    info.first_us = samples.first().time_us;
+    info.last_us = samples.last().time_us;
+    info.offset = file.pos();
+
+    const QByteArray payload = TelemetryArchive::encodeBlock(samples);
+    QDataStream out(&file);
+    out << TelemetryArchive::block_magic << info.oven << info.command << info.count
+        << info.first_us << info.last_us << (quint32)payload.size();
+    out.writeRawData(payload.constData(), payload.size());
+
+    index.append(info);
+    samples.clear();
+}
+
+
+bool TelemetryArchiveReader::open(const QString &file_name) {
+    close();
+    file.setFileName(file_name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // mapped, blocks are decoded straight out of the page cache
+    size = file.size();
+    data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data) {
+        buffer = file.readAll();
+        data = reinterpret_cast<const uchar*>(buffer.constData());
+        size = buffer.size();
+    }
+
+    if (size < header_size || qFromBigEndian<quint32>(data) != TelemetryArchive::file_magic
+            || qFromBigEndian<quint16>(data + 4) != TelemetryArchive::version) {
+        close();
+        error_string = QObject::tr("Not a telemetry archive");
+        return false;
+    }
+
+    // a file whose writer never got to close() has no index, rebuild it
+    if (!readIndex()) {
+        scanBlocks();
+    }
+    return true;
+}
+
+void TelemetryArchiveReader::close() {
+    file.close(); // also unmaps
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+    index.clear();
+    error_string.clear();
+}
+
+QString TelemetryArchiveReader::errorString() const {
+    return error_string.isEmpty() ? file.errorString() : error_string;
+}
+
+const QVector<TelemetryArchive::BlockInfo> &TelemetryArchiveReader::blocks() const {
+    return index;
+}
+
+qint64 TelemetryArchiveReader::dataEnd() const {
+    qint64 end = header_size;
+    for (const TelemetryArchive::BlockInfo &info : index) {
+        quint32 payload_size = qFromBigEndian<quint32>(data + info.offset + block_header_size - 4);
+        end = qMax(end, info.offset + block_header_size + payload_size);
+    }
+    return qMin(end, size);
+}
+
+QVector<TelemetryArchive::Sample> TelemetryArchiveReader::read(quint16 oven, quint8 command,
+                                                               qint64 from_us, qint64 to_us) {
+    QVector<TelemetryArchive::Sample> result;
+    QVector<TelemetryArchive::Sample> block;
+
+    for (const TelemetryArchive::BlockInfo &info : index) {
+        if (info.oven != oven || info.command != command
+                || info.last_us < from_us || info.first_us > to_us) {
+            continue;
+        }
+
+        const uchar *header = data + info.offset;
+        quint32 payload_size = qFromBigEndian<quint32>(header + block_header_size - 4);
+        if (info.offset + block_header_size + payload_size > size) {
+            error_string = QObject::tr("Truncated block at offset %1").arg(info.offset);
+            continue;
+        }
+        const QByteArray payload = QByteArray::fromRawData(
+                    reinterpret_cast<const char*>(header + block_header_size), payload_size);
+        block.clear();
+        if (!TelemetryArchive::decodeBlock(payload, info.count, block)) {
+            error_string = QObject::tr("Corrupt block at offset %1").arg(info.offset);
+            continue;
+        }
+
+        // only the blocks at either end of the range need filtering
+        if (info.first_us >= from_us && info.last_us <= to_us) {
+            result += block;
+        } else {
+            for (const TelemetryArchive::Sample &sample : block) {
+                if (sample.time_us >= from_us && sample.time_us <= to_us) {
+                    result.append(sample);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+bool TelemetryArchiveReader::readIndex() {
+    if (size < header_size + footer_size) {
+        return false;
+    }
+
+    const uchar *footer = data + size - footer_size;
+    qint64 index_offset = qFromBigEndian<qint64>(footer);
+    if (qFromBigEndian<quint32>(footer + 8) != TelemetryArchive::footer_magic
+            || index_offset < header_size || index_offset + 8 > size - footer_size) {
+        return false;
+    }
+
+    const uchar *pos = data + index_offset;
+    quint32 count = qFromBigEndian<quint32>(pos + 4);
+    if (qFromBigEndian<quint32>(pos) != TelemetryArchive::index_magic
+            || index_offset + 8 + (qint64)count * index_entry_size > size - footer_size) {
+        return false;
+    }
+    pos += 8;
+
+    index.clear();
+    index.reserve(count);
+    for (quint32 i=0; i<count; i++) {
+        TelemetryArchive::BlockInfo info;
+        info.oven = qFromBigEndian<quint16>(pos);
+        info.command = pos[2];
+        info.count = qFromBigEndian<quint32>(pos + 3);
+        info.first_us = qFromBigEndian<qint64>(pos + 7);
+        info.last_us = qFromBigEndian<qint64>(pos + 15);
+        info.offset = qFromBigEndian<qint64>(pos + 23);
+        pos += index_entry_size;
+        if (info.offset < header_size || info.offset + block_header_size > size) {
+            index.clear();
+            return false;
+        }
+        index.append(info);
+    }
+    return true;
+}
+
+bool TelemetryArchiveReader::scanBlocks() {
+    index.clear();
+
+    qint64 offset = header_size;
+    while (offset + block_header_size <= size) {
+        const uchar *pos = data + offset;
+        if (qFromBigEndian<quint32>(pos) != TelemetryArchive::block_magic) {
+            break;
+        }
+
+        TelemetryArchive::BlockInfo info;
+        info.offset = offset;
+        info.oven = qFromBigEndian<quint16>(pos + 4);
+        info.command = pos[6];
+        info.count = qFromBigEndian<quint32>(pos + 7);
+        info.first_us = qFromBigEndian<qint64>(pos + 11);
+        info.last_us = qFromBigEndian<qint64>(pos + 19);
+        quint32 payload_size = qFromBigEndian<quint32>(pos + 27);
+        // a block cut short by a crash ends the scan
+        if (offset + block_header_size + payload_size > size) {
+            break;
+        }
+        index.append(info);
+        offset += block_header_size + payload_size;
+    }
+    return !index.isEmpty();
+}
@@ -0,0 +1,97 @@
+#ifndef TELEMETRYARCHIVE_H
+#define TELEMETRYARCHIVE_H
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+
+// Columnar telemetry file. Samples are kept per oven and command and written in
+// blocks of up to block_samples: timestamps as delta-of-delta, values as deltas,
+// both zigzag varint coded and the block qCompress'ed. An index of every block
+// (oven, command, time range, file offset) is written on close so readers can
+// seek straight to a time range, a file without one is indexed by a block scan.
+//
+//   header  "OVTA" version
+//   block   "OVTB" oven command count first_us last_us payload_size payload
+//   index   "OVTI" block_count {oven command count first_us last_us offset}...
+//   footer  index_offset "OVTF"
+class TelemetryArchive
+{
+public:
+    struct Sample {
+        qint64 time_us; // wall clock, microseconds since the epoch
+        qint32 value;   // as read from the controller
+    };
+
+    struct BlockInfo {
+        quint16 oven = 0;
+        quint8 command = 0;
+        quint32 count = 0;
+        qint64 first_us = 0;
+        qint64 last_us = 0;
+        qint64 offset = 0;
+    };
+
+    static const quint32 file_magic = 0x4F565441;   // OVTA
+    static const quint32 block_magic = 0x4F565442;  // OVTB
+    static const quint32 index_magic = 0x4F565449;  // OVTI
+    static const quint32 footer_magic = 0x4F565446; // OVTF
+    static const quint16 version = 1;
+    static const int block_samples = 4096;
+
+    static QByteArray encodeBlock(const QVector<Sample> &samples);
+    static bool decodeBlock(const QByteArray &payload, quint32 count, QVector<Sample> &samples);
+};
+
+class TelemetryArchiveWriter
+{
+public:
+    ~TelemetryArchiveWriter();
+
+    bool open(const QString &file_name);
+    // continues an existing archive after its last complete block, the old index is rewritten on close
+    bool openAppend(const QString &file_name);
+    void close(); // flushes every column and writes the index
+    bool isOpen() const;
+    QString errorString() const;
+    QString fileName() const;
+    qint64 writtenSize() const; // end of the last block on disk, partly filled columns not included
+
+    void append(quint16 oven, quint8 command, qint64 time_us, qint32 value);
+    void flush(); // writes out all partly filled blocks
+
+private:
+    void writeBlock(quint16 oven, quint8 command, QVector<TelemetryArchive::Sample> &samples);
+
+    QFile file;
+    QHash<quint32, QVector<TelemetryArchive::Sample>> columns; // oven << 8 | command
+    QVector<TelemetryArchive::BlockInfo> index;
+};
+
+// Maps the file and decodes blocks in place, one reader per thread
+class TelemetryArchiveReader
+{
+public:
+    bool open(const QString &file_name);
+    void close();
+    QString errorString() const;
+
+    const QVector<TelemetryArchive::BlockInfo> &blocks() const;
+    qint64 dataEnd() const; // end of the last complete block
+    // every sample of one column with from_us <= time_us <= to_us, in time order
+    QVector<TelemetryArchive::Sample> read(quint16 oven, quint8 command,
+                                           qint64 from_us, qint64 to_us);
+
+private:
+    bool readIndex();
+    bool scanBlocks();
+
+    QFile file;
+    const uchar *data = nullptr; // whole file, mapped or in buffer
+    qint64 size = 0;
+    QByteArray buffer; // only when the file can not be mapped
+    QVector<TelemetryArchive::BlockInfo> index;
+    QString error_string;
+};
+
+#endif // TELEMETRYARCHIVE_H
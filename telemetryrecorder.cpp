@@ -0,0 +1,97 @@
+#include "telemetryrecorder.h"
+#include <QDateTime>
+
+TelemetryRecorder::TelemetryRecorder(OvenComm *oven, quint16 oven_id, QObject *parent)
+    : QObject(parent), oven(oven), oven_id(oven_id) {
+    flush_timer.setInterval(60000);
+    connect(&flush_timer, &QTimer::timeout, this, [this]() { writer.flush(); });
+}
+
+TelemetryRecorder::~TelemetryRecorder() {
+    stop();
+}
+
+bool TelemetryRecorder::start(const QString &file_name) {
+    stop();
+    if (!writer.open(file_name)) {
+        return false;
+    }
+    attach();
+    return true;
+}
+
+bool TelemetryRecorder::resume(const QString &file_name) {
+    stop();
+    if (!writer.openAppend(file_name)) {
+        return false;
+    }
+    attach();
+    return true;
+}
+
+void TelemetryRecorder::attach() {
+    wall_offset_ns = QDateTime::currentMSecsSinceEpoch() * 1000000 - SerialComm::monotonicNs();
+    connect(oven, &OvenComm::returnData, this, &TelemetryRecorder::recordData);
+    connect(oven, &OvenComm::returnSnapshot, this, &TelemetryRecorder::recordSnapshot);
+    connect(oven, &OvenComm::errorSignal, this, &TelemetryRecorder::recordError);
+    flush_timer.start();
+}
+
+void TelemetryRecorder::stop() {
+    if (!writer.isOpen()) {
+        return;
+    }
+    disconnect(oven, nullptr, this, nullptr);
+    flush_timer.stop();
+    writer.close();
+}
+
+bool TelemetryRecorder::isRecording() const {
+    return writer.isOpen();
+}
+
+QString TelemetryRecorder::errorString() const {
+    return writer.errorString();
+}
+
+QString TelemetryRecorder::fileName() const {
+    return writer.isOpen() ? writer.fileName() : QString();
+}
+
+qint64 TelemetryRecorder::archiveOffset() const {
+    return writer.writtenSize();
+}
+
+qint64 TelemetryRecorder::wallClockUs(qint64 monotonic_ns) const {
+    if (monotonic_ns == 0) {
+        monotonic_ns = SerialComm::monotonicNs();
+    }
+    return (monotonic_ns + wall_offset_ns) / 1000;
+}
+
+//Slots
+void TelemetryRecorder::recordData(int value, int command_sent, SerialComm::FrameTimes times) {
+    // decoded_ns is only set for a reply off the wire. A cache hit carries an older
+    // sample time and a deduplicated write was never sent, either would put a block out
+    // of time order and record a change that did not happen.
+    if (times.decoded_ns == 0) {
+        return;
+    }
+    writer.append(oven_id, command_sent, wallClockUs(times.last_byte_ns), value);
+}
+
+void TelemetryRecorder::recordSnapshot(OvenComm::Snapshot snapshot) {
+    // back to the raw controller values, see OvenComm::updateSnapshot
+    qint64 time_us = wallClockUs(snapshot.sampled_ns);
+    writer.append(oven_id, OvenComm::GETTEMP, time_us, qRound(snapshot.temp * 100.0));
+    writer.append(oven_id, OvenComm::GETSETTEMP, time_us, qRound(snapshot.set_temp * 100.0));
+    writer.append(oven_id, OvenComm::GETOUTPUT, time_us, qRound(snapshot.output * 28800.0));
+    writer.append(oven_id, OvenComm::GETSENSORSTATUS, time_us, snapshot.sensor_status);
+    writer.append(oven_id, OvenComm::GETPOWERSTATUS, time_us, snapshot.power_status);
+}
+
+void TelemetryRecorder::recordError(QSerialPort::SerialPortError error, QString error_string, int command_sent) {
+    Q_UNUSED(error);
+    Q_UNUSED(error_string);
+    writer.append(oven_id, OvenComm::NONE, wallClockUs(0), command_sent);
+}
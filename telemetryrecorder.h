@@ -0,0 +1,45 @@
+#ifndef TELEMETRYRECORDER_H
+#define TELEMETRYRECORDER_H
+
+#include <QObject>
+#include <QTimer>
+#include "ovencomm.h"
+#include "telemetryarchive.h"
+
+// Appends every decoded reply of one OvenComm to an archive, partly filled
+// blocks are written out once a minute. Errors go in the NONE column with
+// the failed command as the value.
+class TelemetryRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TelemetryRecorder(OvenComm *oven, quint16 oven_id = 0, QObject *parent = nullptr);
+    ~TelemetryRecorder();
+
+    bool start(const QString &file_name);
+    bool resume(const QString &file_name); // appends to an archive from an earlier run
+    void stop();
+    bool isRecording() const;
+    QString errorString() const;
+    QString fileName() const;
+    qint64 archiveOffset() const;
+
+private:
+    void attach();
+    qint64 wallClockUs(qint64 monotonic_ns) const;
+
+    OvenComm *oven;
+    quint16 oven_id;
+    TelemetryArchiveWriter writer;
+    QTimer flush_timer; // bounds what a crash can lose to one interval
+    qint64 wall_offset_ns = 0; // wall clock minus SerialComm::monotonicNs()
+
+private slots:
+    void recordData(int value, int command_sent, SerialComm::FrameTimes times);
+    void recordSnapshot(OvenComm::Snapshot snapshot);
+    void recordError(QSerialPort::SerialPortError error, QString error_string, int command_sent);
+};
+
+
+#endif // TELEMETRYRECORDER_H
@@ -0,0 +1,231 @@
+#include "telemetryserver.h"
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTcpSocket>
+
+static QByteArray sseEvent(const char *event, const QJsonObject &data) {
+    return QByteArray("event: ") + event + "\ndata: " + QJsonDocument(data).toJson(QJsonDocument::Compact) + "\n\n";
+}
+
+TelemetryServer::TelemetryServer(QObject *parent) : QObject(parent) {
+    wall_offset_ns = QDateTime::currentMSecsSinceEpoch() * 1000000 - SerialComm::monotonicNs();
+    connect(&server, &QTcpServer::newConnection, this, &TelemetryServer::newConnection);
+    keepalive_timer.setInterval(15000);
+    connect(&keepalive_timer, &QTimer::timeout, this, [this]() { publish(":\n\n"); });
+}
+
+void TelemetryServer::addOven(quint16 oven_id, OvenComm *oven) {
+    ovens.insert(oven_id, oven);
+    snapshot_body.clear();
+
+    connect(oven, &OvenComm::returnData, this,
+            [this, oven_id, oven](int, int command_sent, SerialComm::FrameTimes times) {
+        // writes are published as the read they confirm, the cache already holds the value sent
+        const ProtocolCommand *entry = OvenCodec::command(command_sent);
+        // decoded_ns is only set for a reply off the wire, a cache hit is not a new sample
+        if (!entry || times.decoded_ns == 0) {
+            return;
+        }
+        snapshot_body.clear();
+        if (subscribers.isEmpty()) {
+            return;
+        }
+        QJsonObject sample;
+        sample["oven"] = oven_id;
+        sample["t"] = wallClockMs(times.last_byte_ns);
+        sample[entry->name] = oven->cachedValue(entry->state).value / entry->scale;
+        publish(sseEvent("sample", sample));
+    });
+    connect(oven, &OvenComm::returnSnapshot, this, [this, oven_id](OvenComm::Snapshot snapshot) {
+        snapshot_body.clear();
+        if (subscribers.isEmpty()) {
+            return;
+        }
+        QJsonObject sample;
+        sample["oven"] = oven_id;
+        sample["t"] = wallClockMs(snapshot.sampled_ns);
+        sample["temp"] = snapshot.temp;
+        sample["set_temp"] = snapshot.set_temp;
+        sample["output"] = snapshot.output;
+        sample["sensor_status"] = snapshot.sensor_status ? 1.0 : 0.0;
+        sample["power_status"] = snapshot.power_status ? 1.0 : 0.0;
+        publish(sseEvent("sample", sample));
+    });
+    connect(oven, &OvenComm::errorSignal, this,
+            [this, oven_id](QSerialPort::SerialPortError error, QString error_string, int command_sent) {
+        snapshot_body.clear();
+        if (subscribers.isEmpty()) {
+            return;
+        }
+        QJsonObject event;
+        event["oven"] = oven_id;
+        event["t"] = wallClockMs(0);
+        event["error"] = (int)error;
+        event["message"] = error_string;
+        event["command"] = command_sent;
+        publish(sseEvent("error", event));
+    });
+}
+
+bool TelemetryServer::listen(const QHostAddress &address, quint16 port) {
+    return server.listen(address, port);
+}
+
+void TelemetryServer::close() {
+    server.close();
+    keepalive_timer.stop();
+    for (QTcpSocket *socket : subscribers) {
+        socket->abort();
+    }
+    for (QTcpSocket *socket : requests.keys()) {
+        socket->abort();
+    }
+}
+
+bool TelemetryServer::isListening() const {
+    return server.isListening();
+}
+
+quint16 TelemetryServer::serverPort() const {
+    return server.serverPort();
+}
+
+QString TelemetryServer::errorString() const {
+    return server.errorString();
+}
+
+int TelemetryServer::subscriberCount() const {
+    return subscribers.size();
+}
+
+//Private
+void TelemetryServer::newConnection() {
+    while (QTcpSocket *socket = server.nextPendingConnection()) {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        requests.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { readRequest(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            requests.remove(socket);
+            subscribers.removeOne(socket);
+            if (subscribers.isEmpty()) {
+                keepalive_timer.stop();
+            }
+            socket->deleteLater();
+        });
+    }
+}
+
+void TelemetryServer::readRequest(QTcpSocket *socket) {
+    if (!requests.contains(socket)) {
+        socket->readAll(); // subscribers have nothing more to say
+        return;
+    }
+    QByteArray &request = requests[socket];
+    request += socket->readAll();
+
+    const int header_end = request.indexOf("\r\n\r\n");
+    if (header_end == -1) {
+        if (request.length() > max_request_bytes) {
+            respond(socket, "431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+        }
+        return;
+    }
+
+    // only the request line matters, no endpoint takes headers or a body
+    const QList<QByteArray> request_line = request.left(request.indexOf("\r\n")).split(' ');
+    requests.remove(socket);
+    if (request_line.length() != 3 || request_line[0] != "GET") {
+        respond(socket, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+        return;
+    }
+    const QByteArray path = request_line[1].split('?').first();
+    if (path == "/api/snapshot") {
+        respond(socket, "200 OK", "application/json", snapshotBody());
+    } else if (path == "/api/stream") {
+        subscribe(socket);
+    } else {
+        respond(socket, "404 Not Found", "text/plain", "Try /api/snapshot or /api/stream\n");
+    }
+}
+
+void TelemetryServer::respond(QTcpSocket *socket, const QByteArray &status, const QByteArray &content_type,
+                              const QByteArray &body) {
+    requests.remove(socket);
+    QByteArray header = "HTTP/1.1 " + status + "\r\n"
+            "Content-Type: " + content_type + "\r\n"
+            "Content-Length: " + QByteArray::number(body.length()) + "\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n\r\n";
+    socket->write(header);
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+void TelemetryServer::subscribe(QTcpSocket *socket) {
+    socket->write("HTTP/1.1 200 OK\r\n"
+                  "Content-Type: text/event-stream\r\n"
+                  "Access-Control-Allow-Origin: *\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: keep-alive\r\n\r\n"
+                  "retry: 2000\n\n");
+    // the current state first, so a new viewer does not wait for every value to be polled again
+    socket->write("event: snapshot\ndata: " + snapshotBody() + "\n\n");
+    subscribers.append(socket);
+    if (!keepalive_timer.isActive()) {
+        keepalive_timer.start();
+    }
+}
+
+void TelemetryServer::publish(const QByteArray &event) {
+    // subscribers is changed by disconnected, which abort() can emit right away
+    const QList<QTcpSocket*> targets = subscribers;
+    for (QTcpSocket *socket : targets) {
+        if (socket->bytesToWrite() > max_backlog_bytes) {
+            // a stalled viewer must not grow our memory, the browser reconnects and gets a snapshot
+            socket->abort();
+            continue;
+        }
+        socket->write(event);
+    }
+}
+
+QByteArray TelemetryServer::snapshotBody() {
+    if (snapshot_body.isEmpty()) {
+        QJsonArray list;
+        for (auto it = ovens.constBegin(); it != ovens.constEnd(); ++it) {
+            list.append(ovenJson(it.key(), it.value()));
+        }
+        QJsonObject root;
+        root["t"] = wallClockMs(0);
+        root["ovens"] = list;
+        snapshot_body = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    }
+    return snapshot_body;
+}
+
+QJsonObject TelemetryServer::ovenJson(quint16 oven_id, OvenComm *oven) const {
+    QJsonObject object;
+    object["oven"] = oven_id;
+    object["connected"] = oven->isOpen();
+    for (int command : {OvenComm::GETTEMP, OvenComm::GETSETTEMP, OvenComm::GETOUTPUT,
+                        OvenComm::GETSENSORSTATUS, OvenComm::GETPOWERSTATUS}) {
+        const ProtocolCommand *entry = OvenCodec::command(command);
+        const OvenComm::CachedValue cached = oven->cachedValue(command);
+        if (cached.valid) {
+            QJsonObject value;
+            value["value"] = cached.value / entry->scale;
+            value["t"] = wallClockMs(cached.updated_ns);
+            object[entry->name] = value;
+        }
+    }
+    return object;
+}
+
+qint64 TelemetryServer::wallClockMs(qint64 monotonic_ns) const {
+    if (monotonic_ns == 0) {
+        monotonic_ns = SerialComm::monotonicNs();
+    }
+    return (monotonic_ns + wall_offset_ns) / 1000000;
+}
@@ -0,0 +1,65 @@
+#ifndef TELEMETRYSERVER_H
+#define TELEMETRYSERVER_H
+
+#include <QObject>
+#include <QHash>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QList>
+#include <QTcpServer>
+#include <QTimer>
+#include "ovencomm.h"
+
+class QTcpSocket;
+
+// Read-only HTTP endpoint for browser dashboards.
+//
+//   GET /api/snapshot   latest value of every oven as JSON, from the OvenComm state cache
+//   GET /api/stream     Server-Sent Events, a "snapshot" event first and then one
+//                       "sample" event per reply read off the wire (values served from
+//                       the cache are not new samples), "error" events for link errors
+//
+// Every sample is serialised once into an implicitly shared QByteArray and that same
+// buffer is written to each subscriber, the snapshot body is only rebuilt after a
+// change. Subscribers that fall too far behind are disconnected instead of buffered.
+class TelemetryServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TelemetryServer(QObject *parent = nullptr);
+
+    void addOven(quint16 oven_id, OvenComm *oven);
+
+    // localhost unless told otherwise, there is no authentication
+    bool listen(const QHostAddress &address = QHostAddress::LocalHost, quint16 port = 8080);
+    void close();
+    bool isListening() const;
+    quint16 serverPort() const;
+    QString errorString() const;
+    int subscriberCount() const;
+
+    static const int max_request_bytes = 8192;
+    static const int max_backlog_bytes = 256 * 1024; // per subscriber, about a minute of samples
+
+private:
+    void newConnection();
+    void readRequest(QTcpSocket *socket);
+    void respond(QTcpSocket *socket, const QByteArray &status, const QByteArray &content_type,
+                 const QByteArray &body);
+    void subscribe(QTcpSocket *socket);
+    void publish(const QByteArray &event);
+    QByteArray snapshotBody();
+    QJsonObject ovenJson(quint16 oven_id, OvenComm *oven) const;
+    qint64 wallClockMs(qint64 monotonic_ns) const;
+
+    QTcpServer server;
+    QHash<quint16, OvenComm*> ovens;
+    QHash<QTcpSocket*, QByteArray> requests; // sockets still sending their request
+    QList<QTcpSocket*> subscribers;
+    QByteArray snapshot_body; // empty when a change came in since it was built
+    QTimer keepalive_timer; // keeps proxies from closing an idle stream
+    qint64 wall_offset_ns = 0; // wall clock minus SerialComm::monotonicNs()
+};
+
+#endif // TELEMETRYSERVER_H
@@ -0,0 +1,227 @@
+#include "timerwheel.h"
+#include <QtAlgorithms>
+
+WheelTimer::~WheelTimer() {
+    if (wheel != nullptr) {
+        wheel->forget(this);
+    }
+}
+
+void WheelTimer::setCallback(const std::function<void()> &callback) {
+    this->callback = callback;
+}
+
+void WheelTimer::setInterval(int msec) {
+    interval_ms = msec;
+}
+
+int WheelTimer::interval() const {
+    return interval_ms;
+}
+
+void WheelTimer::setSingleShot(bool single_shot) {
+    this->single_shot = single_shot;
+}
+
+bool WheelTimer::isSingleShot() const {
+    return single_shot;
+}
+
+void WheelTimer::start() {
+    start(interval_ms);
+}
+
+void WheelTimer::start(int msec) {
+    // like QTimer, starting an active timer restarts it
+    interval_ms = msec;
+    if (wheel == nullptr) {
+        wheel = TimerWheel::instance();
+    }
+    wheel->arm(this, msec);
+}
+
+void WheelTimer::stop() {
+    if (wheel != nullptr) {
+        wheel->cancel(this);
+    }
+}
+
+bool WheelTimer::isActive() const {
+    return active;
+}
+
+
+TimerWheel *TimerWheel::instance() {
+    // belongs to the thread doing the I/O, same as EpollSerialLoop
+    static thread_local TimerWheel *wheel = nullptr;
+    if (wheel == nullptr) {
+        wheel = new TimerWheel();
+    }
+    return wheel;
+}
+
+TimerWheel::TimerWheel(QObject *parent) : QObject(parent) {
+    clock.start();
+    wakeup.setSingleShot(true);
+    wakeup.setTimerType(Qt::PreciseTimer);
+    connect(&wakeup, &QTimer::timeout, this, &TimerWheel::advance);
+    firing.reserve(64);
+}
+
+void TimerWheel::arm(WheelTimer *timer, int msec) {
+    if (timer->slot != -1) {
+        unlink(timer);
+    }
+
+    // an empty wheel has nothing to catch up on, the first timer after an idle spell
+    // must not make advance() walk every tick since
+    if (armed_count == 0 && !advancing) {
+        current_tick = qMax(current_tick, nowTick());
+    }
+
+    // count from now, the wheel itself may be a few ticks behind
+    qint64 ticks = qMax<qint64>(1, (msec + tick_ms - 1) / tick_ms);
+    qint64 target_tick = nowTick() + ticks;
+    qint64 distance = qMax<qint64>(1, target_tick - current_tick);
+    target_tick = current_tick + distance;
+
+    int slot = target_tick % slot_count;
+    timer->slot = slot;
+    timer->rounds = (distance - 1) / slot_count;
+    timer->prev = nullptr;
+    timer->next = wheel_slots[slot];
+    if (timer->next != nullptr) {
+        timer->next->prev = timer;
+    }
+    wheel_slots[slot] = timer;
+    occupied[slot / 64] |= Q_UINT64_C(1) << (slot % 64);
+    timer->active = true;
+    armed_count++;
+
+    if (!advancing && (!wakeup.isActive() || target_tick < wakeup_tick)) {
+        startWakeup(target_tick);
+    }
+}
+
+void TimerWheel::cancel(WheelTimer *timer) {
+    if (timer->slot != -1) {
+        unlink(timer);
+    }
+    // also covers a timer that expired and is waiting in firing
+    timer->active = false;
+}
+
+void TimerWheel::forget(WheelTimer *timer) {
+    cancel(timer);
+    firing.removeAll(timer);
+}
+
+int TimerWheel::armedCount() const {
+    return armed_count;
+}
+
+//Private
+qint64 TimerWheel::nowTick() const {
+    return clock.elapsed() / tick_ms;
+}
+
+void TimerWheel::unlink(WheelTimer *timer) {
+    if (timer->prev != nullptr) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel_slots[timer->slot] = timer->next;
+        if (timer->next == nullptr) {
+            occupied[timer->slot / 64] &= ~(Q_UINT64_C(1) << (timer->slot % 64));
+        }
+    }
+    if (timer->next != nullptr) {
+        timer->next->prev = timer->prev;
+    }
+    timer->prev = nullptr;
+    timer->next = nullptr;
+    timer->slot = -1;
+    armed_count--;
+}
+
+qint64 TimerWheel::nextArmedTick() const {
+    // entries with rounds left still need their slot visited, so any non-empty slot counts
+    const int start = (current_tick + 1) % slot_count;
+    for (int n=0; n<=word_count; n++) {
+        const int word = (start / 64 + n) % word_count;
+        quint64 bits = occupied[word];
+        if (n == 0) {
+            bits &= ~Q_UINT64_C(0) << (start % 64);
+        } else if (n == word_count) {
+            bits &= (Q_UINT64_C(1) << (start % 64)) - 1; // back at the first word, the slots before start
+        }
+        if (bits != 0) {
+            const int slot = word * 64 + qCountTrailingZeroBits(bits);
+            return current_tick + 1 + (slot - start + slot_count) % slot_count;
+        }
+    }
+    return -1;
+}
+
+void TimerWheel::startWakeup(qint64 tick) {
+    wakeup_tick = tick;
+    wakeup.start(qMax<qint64>(0, tick - nowTick()) * tick_ms);
+}
+
+void TimerWheel::scheduleWakeup() {
+    const qint64 tick = armed_count == 0 ? -1 : nextArmedTick();
+    if (tick == -1) {
+        wakeup.stop();
+        wakeup_tick = -1;
+        return;
+    }
+    startWakeup(tick);
+}
+
+//Slots
+void TimerWheel::advance() {
+    qint64 now_tick = nowTick();
+    advancing = true;
+
+    while (current_tick < now_tick) {
+        // empty slots have no rounds to count down, go straight to the next occupied one
+        const qint64 next_tick = nextArmedTick();
+        if (next_tick == -1 || next_tick > now_tick) {
+            current_tick = now_tick;
+            break;
+        }
+        current_tick = next_tick;
+        int slot = current_tick % slot_count;
+
+        // collect first, callbacks are free to arm and cancel anything
+        WheelTimer *timer = wheel_slots[slot];
+        while (timer != nullptr) {
+            WheelTimer *next = timer->next;
+            if (timer->rounds > 0) {
+                timer->rounds--;
+            } else {
+                unlink(timer);
+                firing.append(timer);
+            }
+            timer = next;
+        }
+
+        // popped one by one so a nested event loop inside a callback can carry on the same list
+        while (!firing.isEmpty()) {
+            WheelTimer *expired = firing.takeFirst();
+            if (!expired->active || expired->slot != -1) {
+                continue; // stopped or restarted by an earlier callback
+            }
+            if (expired->single_shot) {
+                expired->active = false;
+            } else {
+                arm(expired, expired->interval_ms);
+            }
+            if (expired->callback) {
+                expired->callback();
+            }
+        }
+    }
+
+    advancing = false;
+    scheduleWakeup();
+}
@@ -0,0 +1,94 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+#include <functional>
+
+class TimerWheel;
+
+// Drop-in for the QTimer subset SerialComm uses (start/stop/isActive/interval).
+// Arming and cancelling only relink the timer in its wheel slot.
+class WheelTimer
+{
+public:
+    WheelTimer() = default;
+    ~WheelTimer();
+
+    void setCallback(const std::function<void()> &callback);
+    void setInterval(int msec);
+    int interval() const;
+    void setSingleShot(bool single_shot);
+    bool isSingleShot() const;
+
+    void start();
+    void start(int msec);
+    void stop();
+    bool isActive() const;
+
+private:
+    friend class TimerWheel;
+
+    std::function<void()> callback;
+    int interval_ms = 0;
+    bool single_shot = false;
+    bool active = false;
+
+    // wheel bookkeeping
+    TimerWheel *wheel = nullptr;
+    WheelTimer *prev = nullptr;
+    WheelTimer *next = nullptr;
+    int slot = -1;
+    int rounds = 0;
+};
+
+// Hashed timer wheel shared by every WheelTimer of a thread, with 1 ms ticks.
+// Expiry work is one slot walk per elapsed tick and a single QTimer is kept
+// pointed at the next non-empty slot, so the event dispatcher sees one timer
+// no matter how many links and requests are armed. Arming is O(1) and only
+// restarts the QTimer when it moves the wakeup earlier, cancelling leaves it
+// alone (at worst one wakeup finds nothing due). The next non-empty slot is
+// found through an occupancy bitmap, a few word tests rather than a slot scan.
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int tick_ms = 1;
+    static const int slot_count = 1024;
+
+    static TimerWheel *instance();
+
+    void arm(WheelTimer *timer, int msec);
+    void cancel(WheelTimer *timer);
+    void forget(WheelTimer *timer);
+    int armedCount() const;
+
+private:
+    explicit TimerWheel(QObject *parent = nullptr);
+
+    qint64 nowTick() const;
+    void unlink(WheelTimer *timer);
+    qint64 nextArmedTick() const; // first tick after current_tick with a non-empty slot, -1 if none
+    void startWakeup(qint64 tick);
+    void scheduleWakeup();
+
+    static const int word_count = slot_count / 64;
+
+    WheelTimer *wheel_slots[slot_count] = {};
+    quint64 occupied[word_count] = {}; // bit per slot, set while the slot has timers
+    int armed_count = 0;
+    qint64 current_tick = 0; // last tick whose slot has been processed
+    qint64 wakeup_tick = -1;
+    bool advancing = false; // advance() schedules the wakeup once it is done
+    QElapsedTimer clock;
+    QTimer wakeup;
+    QVector<WheelTimer *> firing;
+
+private slots:
+    void advance();
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,111 @@
+#include <QtTest>
+#include <QTcpServer>
+#include "profileengine.h"
+
+// A restarted station hands the engine the setpoint it read back from the controller,
+// these check that the first tick does not write it again, and that the engine only
+// finishes once the last setpoint is in effect.
+class ProfileEngineTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // the link only has to count as open, the gateway never answers so a SETTEMP stays pending
+    static void openOven(OvenComm &oven, const QTcpServer &gateway) {
+        SettingsDialog::Settings settings;
+        settings.name = QString("tcp://127.0.0.1:%1/0").arg(gateway.serverPort());
+        settings.baudRate = QSerialPort::Baud9600;
+        settings.dataBits = QSerialPort::Data8;
+        settings.parity = QSerialPort::NoParity;
+        settings.stopBits = QSerialPort::OneStop;
+        settings.flowControl = QSerialPort::NoFlowControl;
+        settings.localEchoEnabled = false;
+        settings.lowLatency = false;
+        settings.autoConnect = false;
+        oven.updateSerialInfo(settings);
+        oven.openSerialPort();
+    }
+
+private slots:
+    void seededSetpointIsNotResent() {
+        QTcpServer gateway;
+        QVERIFY(gateway.listen(QHostAddress::LocalHost));
+        OvenComm oven; // cache off, as on oven 0, so nothing but the seed stops the write
+        openOven(oven, gateway);
+        QVERIFY(oven.isOpen());
+
+        ProfileEngine engine(&oven);
+        engine.setProfile({{0, 50.0}, {60000, 50.0}});
+        QSignalSpy sent(&engine, &ProfileEngine::setpointChanged);
+        engine.start(30000, 5000);
+        QCOMPARE(sent.count(), 0);
+        QVERIFY(!oven.hasPendingRequest(OvenComm::SETTEMP));
+        engine.stop();
+    }
+
+    void differentSetpointIsSent() {
+        QTcpServer gateway;
+        QVERIFY(gateway.listen(QHostAddress::LocalHost));
+        OvenComm oven;
+        openOven(oven, gateway);
+
+        ProfileEngine engine(&oven);
+        engine.setProfile({{0, 50.0}, {60000, 50.0}});
+        QSignalSpy sent(&engine, &ProfileEngine::setpointChanged);
+        engine.start(30000, 4000);
+        QCOMPARE(sent.count(), 1);
+        QCOMPARE(sent.first().first().toDouble(), 50.0);
+        QVERIFY(oven.hasPendingRequest(OvenComm::SETTEMP));
+        engine.stop();
+    }
+
+    void unseededStartSends() {
+        QTcpServer gateway;
+        QVERIFY(gateway.listen(QHostAddress::LocalHost));
+        OvenComm oven;
+        openOven(oven, gateway);
+
+        ProfileEngine engine(&oven);
+        engine.setProfile({{0, 50.0}, {60000, 50.0}});
+        QSignalSpy sent(&engine, &ProfileEngine::setpointChanged);
+        engine.start();
+        QCOMPARE(sent.count(), 1);
+        QVERIFY(oven.hasPendingRequest(OvenComm::SETTEMP));
+        engine.stop();
+    }
+
+    void runsUntilLastSetpointConfirmed() {
+        QTcpServer gateway;
+        QVERIFY(gateway.listen(QHostAddress::LocalHost));
+        OvenComm oven;
+        openOven(oven, gateway);
+
+        ProfileEngine engine(&oven);
+        engine.setProfile({{0, 40.0}, {1000, 50.0}});
+        QSignalSpy finished(&engine, &ProfileEngine::profileFinished);
+        engine.start(2000); // past the end, the write is not answered yet
+        QVERIFY(oven.hasPendingRequest(OvenComm::SETTEMP));
+        QCOMPARE(finished.count(), 0);
+        QVERIFY(engine.isRunning());
+        engine.stop();
+    }
+
+    void finishesWhenLastSetpointInEffect() {
+        QTcpServer gateway;
+        QVERIFY(gateway.listen(QHostAddress::LocalHost));
+        OvenComm oven;
+        openOven(oven, gateway);
+
+        ProfileEngine engine(&oven);
+        engine.setProfile({{0, 40.0}, {1000, 50.0}});
+        QSignalSpy finished(&engine, &ProfileEngine::profileFinished);
+        engine.start(2000, 5000);
+        QCOMPARE(finished.count(), 1);
+        QVERIFY(!engine.isRunning());
+        QVERIFY(!oven.hasPendingRequest(OvenComm::SETTEMP));
+    }
+};
+
+QTEST_GUILESS_MAIN(ProfileEngineTest)
+
+#include "tst_profileengine.moc"
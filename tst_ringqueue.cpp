@@ -0,0 +1,134 @@
+#include <QtTest>
+#include <memory>
+#include "ringqueue.h"
+
+// RingQueue is what keeps SerialComm's queues off the heap, these pin down the index
+// arithmetic once the contents wrap around the end of the slots.
+class RingQueueTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QList<int> contents(const RingQueue<int> &queue) {
+        QList<int> values;
+        for (int value : queue) {
+            values.append(value);
+        }
+        return values;
+    }
+
+    // front moved to the middle, so the four values sit in slots 2, 3, 0 and 1
+    static void fillWrapped(RingQueue<int> &queue) {
+        queue.reserve(4);
+        queue.enqueue(-2);
+        queue.enqueue(-1);
+        queue.enqueue(1);
+        queue.dequeue();
+        queue.dequeue();
+        queue.enqueue(2);
+        queue.enqueue(3);
+        queue.enqueue(4);
+    }
+
+private slots:
+    void wrapsAround() {
+        RingQueue<int> queue(4);
+        fillWrapped(queue);
+        QCOMPARE(contents(queue), QList<int>({1, 2, 3, 4}));
+        QCOMPARE(queue.first(), 1);
+        QCOMPARE(queue.last(), 4);
+        QCOMPARE(queue[3], 4);
+        QCOMPARE(queue.capacity(), 4);
+        QCOMPARE(queue.growCount(), 0);
+
+        for (int expected=1; expected<=4; expected++) {
+            QCOMPARE(queue.dequeue(), expected);
+        }
+        QVERIFY(queue.isEmpty());
+    }
+
+    void prependWrapsBelowSlotZero() {
+        RingQueue<int> queue(4);
+        queue.enqueue(2);
+        queue.enqueue(3);
+        queue.prepend(1); // front was slot 0
+        queue.prepend(0);
+        QCOMPARE(contents(queue), QList<int>({0, 1, 2, 3}));
+        QCOMPARE(queue.growCount(), 0);
+
+        queue.removeLast();
+        queue.prepend(-1);
+        QCOMPARE(contents(queue), QList<int>({-1, 0, 1, 2}));
+        QCOMPARE(queue.growCount(), 0);
+    }
+
+    void takeAtNearFront() {
+        RingQueue<int> queue;
+        fillWrapped(queue);
+        QCOMPARE(queue.takeAt(1), 2);
+        QCOMPARE(contents(queue), QList<int>({1, 3, 4}));
+        queue.enqueue(5);
+        QCOMPARE(contents(queue), QList<int>({1, 3, 4, 5}));
+    }
+
+    void takeAtNearBack() {
+        RingQueue<int> queue;
+        fillWrapped(queue);
+        QCOMPARE(queue.takeAt(2), 3);
+        QCOMPARE(contents(queue), QList<int>({1, 2, 4}));
+        queue.prepend(0);
+        QCOMPARE(contents(queue), QList<int>({0, 1, 2, 4}));
+    }
+
+    void takeAtEnds() {
+        RingQueue<int> queue;
+        fillWrapped(queue);
+        QCOMPARE(queue.takeAt(0), 1);
+        QCOMPARE(queue.takeAt(queue.length() - 1), 4);
+        QCOMPARE(contents(queue), QList<int>({2, 3}));
+        QCOMPARE(queue.growCount(), 0);
+    }
+
+    void growsInOrderWhenWrapped() {
+        RingQueue<int> queue;
+        fillWrapped(queue);
+        queue.enqueue(5);
+        QCOMPARE(queue.growCount(), 1);
+        QVERIFY(queue.capacity() > 4);
+        QCOMPARE(contents(queue), QList<int>({1, 2, 3, 4, 5}));
+
+        RingQueue<int> front_full;
+        fillWrapped(front_full);
+        front_full.prepend(0);
+        QCOMPARE(front_full.growCount(), 1);
+        QCOMPARE(contents(front_full), QList<int>({0, 1, 2, 3, 4}));
+    }
+
+    void releasesTakenValues() {
+        // a Request gives up its callback as soon as it leaves the queue
+        std::shared_ptr<int> value = std::make_shared<int>(7);
+        RingQueue<std::shared_ptr<int>> queue(4);
+        queue.enqueue(value);
+        queue.enqueue(value);
+        queue.enqueue(value);
+        queue.prepend(value);
+        QCOMPARE(value.use_count(), 5L);
+
+        queue.takeAt(1);
+        QCOMPARE(value.use_count(), 4L);
+        queue.takeAt(2);
+        QCOMPARE(value.use_count(), 3L);
+        queue.dequeue();
+        queue.removeLast();
+        QCOMPARE(value.use_count(), 1L);
+        QVERIFY(queue.isEmpty());
+
+        queue.enqueue(value);
+        queue.clear();
+        QCOMPARE(value.use_count(), 1L);
+    }
+};
+
+QTEST_APPLESS_MAIN(RingQueueTest)
+
+#include "tst_ringqueue.moc"
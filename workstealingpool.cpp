@@ -0,0 +1,103 @@
+#include "workstealingpool.h"
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    int count = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+    count = qMax(1, count);
+
+    for (int i=0; i<count; i++) {
+        workers.append(std::make_shared<Worker>());
+    }
+    for (int i=0; i<count; i++) {
+        this->threads.append(std::thread([this, i]() { run(i); }));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+int WorkStealingPool::threadCount() const {
+    return workers.size();
+}
+
+void WorkStealingPool::submit(const Task &task) {
+    // spread submissions round robin, stealing evens out whatever is left
+    // pending is counted before the task is visible, a worker may take and finish it right away
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        pending++;
+    }
+    Worker &worker = *workers[next_worker++ % workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(task);
+    }
+    // queued only once it can be taken, so a woken worker never spins on an empty deque;
+    // a worker that already took it has brought queued to -1 and this evens it out
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        queued++;
+    }
+    work_available.notify_one();
+}
+
+void WorkStealingPool::waitForDone() {
+    std::unique_lock<std::mutex> lock(state_mutex);
+    all_done.wait(lock, [this]() { return pending == 0; });
+}
+
+bool WorkStealingPool::takeTask(int self, Task &task) {
+    {
+        Worker &own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (int i=1; i<workers.size(); i++) {
+        Worker &victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(int self) {
+    Task task;
+    while (true) {
+        if (takeTask(self, task)) {
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                queued--;
+            }
+            task();
+            task = Task();
+
+            std::lock_guard<std::mutex> lock(state_mutex);
+            if (--pending == 0) {
+                all_done.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(state_mutex);
+        work_available.wait(lock, [this]() { return queued > 0 || stopping; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
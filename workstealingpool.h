@@ -0,0 +1,50 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Fixed set of worker threads, each with its own task deque. A worker takes
+// from the back of its own deque and, once that is empty, steals from the
+// front of the others, so a few huge files do not leave cores idle while one
+// worker still has a backlog of small ones.
+class WorkStealingPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    explicit WorkStealingPool(int threads = 0); // 0 uses every core
+    ~WorkStealingPool();
+
+    int threadCount() const;
+    void submit(const Task &task);
+    void waitForDone();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int self);
+    bool takeTask(int self, Task &task);
+
+    QVector<std::shared_ptr<Worker>> workers;
+    QVector<std::thread> threads;
+    std::atomic<int> next_worker{0};
+
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    int pending = 0; // submitted and not yet finished
+    int queued = 0;  // submitted and not yet taken by a worker
+    bool stopping = false;
+};
+
+#endif // WORKSTEALINGPOOL_H